@@ -6,16 +6,47 @@
 
 #include <ftd3xx/ftd3xx.h>
 
+#include "xx3dsfml.h"
+
 #include <SFML/Audio.hpp>
 #include <SFML/Graphics.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
 #include <cstring>
+#include <ctime>
 #include <filesystem>
 #include <fstream>
-#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <thread>
-#include <queue>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #define NAME "xx3dsfml"
 
@@ -38,6 +69,8 @@
 #define FRAME_SIZE_RGB (CAP_RES * 3)
 #define FRAME_SIZE_RGBA (CAP_RES * 4)
 
+#define RAW_WIDTH (CAP_WIDTH * 3 / 4)
+
 #define AUDIO_CHANNELS 2
 #define SAMPLE_RATE 32734
 
@@ -45,820 +78,6105 @@
 #define SAMPLE_SIZE_16 (SAMPLE_SIZE_8 / 2)
 
 #define BUF_COUNT 8
+#define BUF_LIMIT 32
+#define BUF_POOL 64
+#define BUF_DEPTH 2
+#define QUEUE_SIZE 8
 #define BUF_SIZE (FRAME_SIZE_RGB + SAMPLE_SIZE_8)
 
-#define FRAMERATE_LIMIT 60
+#define FRAME_RATE 59.83
 
-#define SAMPLE_LIMIT 3
-#define DROP_LIMIT 3
+#define STALL_TIME 250
 
-#define TRANSFER_ABORT -1
+#define CONNECT_MIN 50
+#define CONNECT_MAX 2000
 
-const std::string CONF_DIR = std::string(std::getenv("HOME")) + "/.config/" + std::string(NAME) + "/";
+#define TUNE_WINDOW 300
+#define TUNE_CLEAN 12
+#define TUNE_COUNT 16
+#define TUNE_LATE 1.5
 
-bool g_running = true;
-bool g_finished = false;
+#define JITTER_TARGET 50
+#define JITTER_SIZE 16384
+#define JITTER_CHUNK 256
+#define JITTER_MARKERS 64
 
-bool g_safe_mode = false;
+#define JITTER_SMOOTHING 0.05
+#define JITTER_GAIN 0.002
+#define JITTER_INTEGRAL 0.00001
+#define JITTER_LIMIT 0.005
+#define JITTER_EPSILON 0.000001
 
-class Capture {
-public:
-	static inline UCHAR buf[BUF_COUNT][BUF_SIZE];
-	static inline ULONG read[BUF_COUNT];
+#define TRANSFER_ABORT -1
 
-	static inline bool starting = true;
+#define REALTIME_PRIORITY 50
+#define REALTIME_SLAB (2 << 20)
+#define REALTIME_WAIT 1
 
-	static inline bool connected = false;
-	static inline bool disconnecting = false;
+#define BENCH_COUNT 1000
+#define BENCH_PACKETS 600
+#define BENCH_THRESHOLD 10.0
 
-	static inline bool auto_connect = false;
+#define HISTOGRAM_BITS 5
+#define HISTOGRAM_LINEAR (1 << HISTOGRAM_BITS)
+#define HISTOGRAM_EXPONENT 40
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR + (HISTOGRAM_EXPONENT - HISTOGRAM_BITS + 1) * HISTOGRAM_LINEAR / 2)
 
-	static inline bool connect() {
-		if (Capture::connected) {
-			return true;
-		}
+#define HEADLESS_MAGIC 0x53443358
+#define HEADLESS_PIPE (1 << 20)
 
-		if (FT_Create(const_cast<char*>(PRODUCT_1), FT_OPEN_BY_DESCRIPTION, &Capture::handle) && FT_Create(const_cast<char*>(PRODUCT_2), FT_OPEN_BY_DESCRIPTION, &Capture::handle)) {
-			printf("[%s] Create failed.\n", NAME);
-			return false;
-		}
+#define PACING_MIN 55.0
+#define PACING_MAX 65.0
+#define PACING_DELAY 2000
+#define PACING_DEPTH 2
+#define PACING_SMOOTHING 0.01
+#define PACING_TRACKING 0.02
 
-		UCHAR buf[4] = {0x40, 0x80, 0x00, 0x00};
-		ULONG written = 0;
+#define SHOT_COUNT 8
+#define SHOT_STOP -1
 
-		if (FT_WritePipe(Capture::handle, BULK_OUT, buf, 4, &written, 0)) {
-			printf("[%s] Write failed.\n", NAME);
-			return false;
-		}
+#define SCALER_BANDS 8
+#define SCALER_SPLIT (TOP_RES / CAP_WIDTH)
+#define SCALER_PAD (CAP_WIDTH + 4)
 
-		buf[1] = 0x00;
+#define SCALER_HQ_Y 48
+#define SCALER_HQ_U 7
+#define SCALER_HQ_V 6
+#define SCALER_XBR_EQUAL 155
 
-		if (FT_WritePipe(Capture::handle, BULK_OUT, buf, 4, &written, 0)) {
-			printf("[%s] Write failed.\n", NAME);
-			return false;
-		}
+#define EVENT_TIME 2
+#define EVENT_COUNT 64
 
-		if (FT_SetStreamPipe(Capture::handle, false, false, BULK_IN, BUF_SIZE)) {
-			printf("[%s] Stream failed.\n", NAME);
-			return false;
-		}
+#define DIRTY_LINES 16
+#define DIRTY_TILES ((CAP_HEIGHT + DIRTY_LINES - 1) / DIRTY_LINES)
+#define DIRTY_REFRESH 60
 
-		for (int i = 0; i < BUF_COUNT; ++i) {
-			if (FT_InitializeOverlapped(Capture::handle, &Capture::overlap[i])) {
-				printf("[%s] Initialize failed.\n", NAME);
-				return false;
-			}
-		}
+#define STATS_BACKLOG 16
+#define STATS_POLL 100
+#define STATS_INTERVAL 1000
 
-		for (int i = 0; i < BUF_COUNT; ++i) {
-			if (FT_ReadPipeAsync(Capture::handle, FIFO_CHANNEL, Capture::buf[i], BUF_SIZE, &Capture::read[i], &Capture::overlap[i]) != FT_IO_PENDING) {
-				printf("[%s] Read failed.\n", NAME);
-				return false;
-			}
-		}
+#define OVERLAY_INTERVAL 500
+#define OVERLAY_SIZE 12
 
-		return true;
-	}
+#define REPLAY_VERSION 1
+#define REPLAY_NONE INT64_MIN
+#define REPLAY_POLL 5
+#define REPLAY_SEEK 10
 
-	static inline void stream(std::promise<int> *p_audio_promise, std::promise<int> *p_video_promise, bool *p_audio_waiting, bool *p_video_waiting) {
-		while (g_running) {
-			if (!Capture::connected) {
-				if (Capture::auto_connect) {
-					if (!(Capture::connected = Capture::connect())) {
-						sf::sleep(sf::milliseconds(5000));
-					}
-				}
+#define RECORD_VERSION 1
+#define RECORD_RAW 0
+#define RECORD_DELTA 1
 
-				else {
-					sf::sleep(sf::milliseconds(5));
-				}
+#define RECORD_KEYFRAME 0x01
 
-				continue;
-			}
+#define RECORD_COUNT 16
+#define RECORD_BATCH 8
+#define RECORD_STOP -1
 
-			if (Capture::disconnecting || !Capture::transfer()) {
-				Capture::disconnecting = Capture::connected = Capture::disconnect();
-				Capture::signal(p_video_promise, p_video_waiting, TRANSFER_ABORT);
+#define RECORD_ALIGN 4096
+#define RECORD_HEADER 32
+#define RECORD_SIZE ((RECORD_HEADER + BUF_SIZE + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN)
+#define RECORD_STAGE ((RECORD_BATCH * (RECORD_HEADER + CODEC_BOUND) + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN)
 
-				Capture::starting = true;
-				Capture::index = 0;
+#define SOUND_COUNT 64
+#define SOUND_BATCH 16
+#define SOUND_STOP -1
 
-				continue;
-			}
+#define SOUND_HEADER 24
+#define SOUND_SIZE (SOUND_HEADER + SAMPLE_SIZE_8)
+#define SOUND_LATE 3.0
+#define SOUND_SYNC 8
+#define SOUND_LIMIT 0xF0000000u
 
-			Capture::signal(p_audio_promise, p_audio_waiting, Capture::index);
-			Capture::signal(p_video_promise, p_video_waiting, Capture::index);
+#define SOUND_BLOCK 4096
+#define SOUND_ORDER 4
+#define SOUND_PARTITION 6
+#define SOUND_RICE 14
+#define SOUND_RESERVE 8192
+#define SOUND_BOUND (SOUND_BLOCK * AUDIO_CHANNELS * 3 + 64)
 
-			Capture::index = (Capture::index + 1) % BUF_COUNT;
+#define CODEC_BANDS 4
+#define CODEC_KEYFRAME 60
 
-			if (Capture::starting) {
-				Capture::starting = Capture::index;
-			}
-		}
+#define CODEC_WORDS (BUF_SIZE / 8)
+#define CODEC_STRIDE (CAP_WIDTH * 3 * 2 / 8)
+#define CODEC_BOUND (BUF_SIZE * 2)
 
-		Capture::disconnecting = Capture::connected = Capture::disconnect();
+const std::string CONF_DIR = std::string(std::getenv("HOME")) + "/.config/" + std::string(NAME) + "/";
 
-		while (!g_finished) {
-			Capture::signal(p_audio_promise, p_audio_waiting, TRANSFER_ABORT);
-			Capture::signal(p_video_promise, p_video_waiting, TRANSFER_ABORT);
+std::atomic<bool> g_running = true;
+std::atomic<bool> g_finished = false;
 
-			sf::sleep(sf::milliseconds(5));
-		}
-	}
+static_assert(std::atomic<bool>::is_always_lock_free, "Signal flags must be lock-free.");
 
-private:
-	static inline FT_HANDLE handle;
-	static inline OVERLAPPED overlap[BUF_COUNT];
+bool g_safe_mode = false;
 
-	static inline int index = 0;
+template <typename T, int N>
+class Queue {
+public:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "Queue size must be a power of two.");
+
+	int size() {
+		return this->m_tail.load(std::memory_order_acquire) - this->m_head.load(std::memory_order_acquire);
+	}
 
-	static inline bool disconnect() {
-		if (!Capture::connected) {
+	bool push(const T &item) {
+		uint32_t tail = this->m_tail.load(std::memory_order_relaxed);
+
+		if (tail - this->m_head.load(std::memory_order_acquire) == N) {
 			return false;
 		}
 
-		for (int i = 0; i < BUF_COUNT; ++i) {
-			if (FT_ReleaseOverlapped(Capture::handle, &Capture::overlap[i])) {
-				printf("[%s] Release failed.\n", NAME);
-			}
-		}
+		this->m_items[tail % N] = item;
+		this->m_tail.store(tail + 1, std::memory_order_seq_cst);
 
-		if (FT_Close(Capture::handle)) {
-			printf("[%s] Close failed.\n", NAME);
+		if (this->m_waiting.load(std::memory_order_seq_cst)) {
+			this->wake();
 		}
 
-		return false;
+		return true;
 	}
 
-	static inline bool transfer() {
-		if (FT_GetOverlappedResult(Capture::handle, &Capture::overlap[Capture::index], &Capture::read[Capture::index], true) == FT_IO_INCOMPLETE && FT_AbortPipe(Capture::handle, BULK_IN)) {
-			printf("[%s] Abort failed.\n", NAME);
-			return false;
-		}
+	bool pop(T *p_item) {
+		uint32_t head = this->m_head.load(std::memory_order_relaxed);
 
-		if (FT_ReadPipeAsync(Capture::handle, FIFO_CHANNEL, Capture::buf[Capture::index], BUF_SIZE, &Capture::read[Capture::index], &Capture::overlap[Capture::index]) != FT_IO_PENDING) {
-			printf("[%s] Read failed.\n", NAME);
+		if (head == this->m_tail.load(std::memory_order_acquire)) {
 			return false;
 		}
 
+		*p_item = this->m_items[head % N];
+		this->m_head.store(head + 1, std::memory_order_release);
+
 		return true;
 	}
 
-	static inline void signal(std::promise<int> *p_promise, bool *p_waiting, int value) {
-		if (*p_waiting) {
-			*p_waiting = false;
-			p_promise->set_value(value);
+	void wait(T *p_item) {
+		while (!this->pop(p_item)) {
+			this->m_waiting.store(true, std::memory_order_seq_cst);
+			uint32_t tail = this->m_tail.load(std::memory_order_seq_cst);
+
+			if (tail == this->m_head.load(std::memory_order_relaxed)) {
+				this->sleep(tail);
+			}
+
+			this->m_waiting.store(false, std::memory_order_relaxed);
 		}
 	}
-};
 
-class Audio : public sf::SoundStream {
-public:
-	static inline Audio *p_audio;
+private:
+	T m_items[N];
 
-	static inline int volume = 50;
-	static inline bool mute = false;
+	std::atomic<uint32_t> m_head = 0;
+	std::atomic<uint32_t> m_tail = 0;
 
-	static inline std::promise<int> promise;
-	static inline bool waiting = false;
+	std::atomic<bool> m_waiting = false;
 
-	Audio() {
-		this->initialize(AUDIO_CHANNELS, SAMPLE_RATE);
-		this->setVolume(0);
+#if defined(__linux__)
+	void sleep(uint32_t tail) {
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&this->m_tail), FUTEX_WAIT_PRIVATE, tail, nullptr, nullptr, 0);
+	}
 
-		this->play();
+	void wake() {
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&this->m_tail), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
 	}
+#else
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
 
-	static inline void adjust() {
-		Audio::p_audio->setVolume(Audio::starting || Audio::mute ? 0 : Audio::volume);
+	void sleep(uint32_t tail) {
+		std::unique_lock<std::mutex> lock(this->m_mutex);
+		this->m_cond.wait(lock, [&] { return this->m_tail.load(std::memory_order_acquire) != tail; });
 	}
 
-	static inline void playback() {
-		while (g_running) {
-			Audio::promise = std::promise<int>();
-			Audio::waiting = true;
+	void wake() {
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_cond.notify_one();
+	}
+#endif
+};
 
-			int ready = Audio::promise.get_future().get();
+class Bench {
+public:
+	struct Result {
+		std::string name;
+		long long value;
+		std::string unit;
+	};
 
-			if (ready == TRANSFER_ABORT) {
-				continue;
-			}
+	static inline bool enabled = false;
 
-			if (Capture::starting) {
-				Audio::reset();
-				continue;
-			}
+	static inline std::string results;
+	static inline std::string baseline;
+	static inline double threshold = BENCH_THRESHOLD;
 
-			if (!Audio::load(&Capture::buf[ready][FRAME_SIZE_RGB], &Capture::read[ready])) {
-				continue;
-			}
+	static inline void record(std::string name, long long value, std::string unit, bool match = true) {
+		printf("[%s] Bench %s: %lld %s%s.\n", NAME, name.c_str(), value, unit.c_str(), match ? "" : " (mismatch)");
 
-			Audio::index = (Audio::index + 1) % BUF_COUNT;
+		Bench::entries.push_back({ name, value, unit });
+		Bench::failed |= !match;
+	}
 
-			if (Audio::starting) {
-				Audio::starting = Audio::index;
-				Audio::adjust();
-			}
+	static inline int finish() {
+		bool passed = !Bench::failed;
 
-			Audio::unblock();
+		if (!Bench::results.empty()) {
+			passed &= Bench::write(Bench::results);
 		}
 
-		Audio::unblock();
-		delete Audio::p_audio;
+		if (!Bench::baseline.empty()) {
+			passed &= Bench::compare(Bench::baseline);
+		}
+
+		return passed ? 0 : 1;
 	}
 
 private:
-	struct Sample {
-		Sample(sf::Int16 *bytes, std::size_t size) : bytes(bytes), size(size) {}
+	static inline std::vector<Bench::Result> entries;
+	static inline bool failed = false;
 
-		sf::Int16 *bytes;
-		std::size_t size;
-	};
+	static inline bool write(std::string path) {
+		std::ofstream file(path);
 
-	static inline sf::Int16 buf[BUF_COUNT][SAMPLE_SIZE_16];
-	static inline std::queue<Audio::Sample> samples;
+		if (!file.good()) {
+			printf("[%s] File \"%s\" save failed.\n", NAME, path.c_str());
+			return false;
+		}
 
-	static inline bool starting = true;
+		for (Bench::Result &result : Bench::entries) {
+			file << result.name << '\t' << result.value << '\t' << result.unit << std::endl;
+		}
 
-	static inline int index = 0;
-	static inline int drops = 0;
+		return true;
+	}
 
-	static inline std::promise<void> barrier;
-	static inline bool blocked = false;
+	static inline bool compare(std::string path) {
+		std::ifstream file(path);
 
-	static inline void reset() {
-		Audio::unblock();
-		delete Audio::p_audio;
+		if (!file.good()) {
+			printf("[%s] File \"%s\" load failed.\n", NAME, path.c_str());
+			return false;
+		}
 
-		Audio::samples = {};
-		Audio::p_audio = new Audio();
+		std::string line;
+		int regressions = 0;
 
-		Audio::starting = true;
+		while (std::getline(file, line)) {
+			std::istringstream fields(line);
+			Bench::Result base;
 
-		Audio::index = 0;
-		Audio::drops = 0;
-	}
+			if (!std::getline(fields, base.name, '\t') || !(fields >> base.value) || base.value <= 0) {
+				continue;
+			}
 
-	static inline bool load(UCHAR *p_buf, ULONG *p_read) {
-		if (*p_read <= FRAME_SIZE_RGB) {
-			return false;
-		}
+			for (Bench::Result &result : Bench::entries) {
+				if (result.name != base.name) {
+					continue;
+				}
 
-		if (Audio::samples.size() > SAMPLE_LIMIT) {
-			if (++Audio::drops > DROP_LIMIT) {
-				Audio::reset();
-			}
+				double change = 100.0 * (result.value - base.value) / base.value;
+				bool regressed = change > Bench::threshold;
 
-			else {
-				return false;
+				printf("[%s] Compare %s: %lld -> %lld %s (%+.1f%%)%s.\n", NAME, result.name.c_str(), base.value, result.value, result.unit.c_str(), change, regressed ? " (regression)" : "");
+				regressions += regressed;
 			}
 		}
 
-		Audio::drops = 0;
-
-		Audio::map(p_buf, Audio::buf[Audio::index]);
-		Audio::samples.emplace(Audio::buf[Audio::index], (*p_read - FRAME_SIZE_RGB) / 2);
+		printf("[%s] %d regressions beyond %.1f%%.\n", NAME, regressions, Bench::threshold);
 
-		return true;
-	}
-
-	static inline void map(UCHAR *p_in, sf::Int16 *p_out) {
-		for (int i = 0; i < SAMPLE_SIZE_16; ++i) {
-			p_out[i] = p_in[i * 2 + 1] << 8 | p_in[i * 2];
-		}
+		return regressions == 0;
 	}
+};
 
-	static inline void unblock() {
-		if (Audio::blocked) {
-			Audio::blocked = false;
-			Audio::barrier.set_value();
-		}
-	}
+class Realtime {
+public:
+	static_assert(REALTIME_SLAB >= BUF_SIZE, "Slab size must hold at least one packet.");
 
-	bool onGetData(sf::SoundStream::Chunk &data) override {
-		if (Audio::samples.empty()) {
-			Audio::barrier = std::promise<void>();
-			Audio::blocked = true;
+	enum Thread { CAPTURE, AUDIO, RENDER, COUNT };
 
-			Audio::barrier.get_future().wait();
+	static inline int cpus[Realtime::Thread::COUNT] = { -1, -1, -1 };
 
-			if (Audio::samples.empty()) {
-				return false;
-			}
-		}
+	static inline int policy = SCHED_OTHER;
+	static inline int priority = REALTIME_PRIORITY;
 
-		data.samples = Audio::samples.front().bytes;
-		data.sampleCount = Audio::samples.front().size;
+	static inline bool lock = false;
 
-		Audio::samples.pop();
+	static inline void apply(std::string name, Realtime::Thread thread, const char *p_role) {
+		std::string granted;
 
-		return true;
-	}
+		if (Realtime::cpus[thread] >= 0) {
+#if defined(__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(Realtime::cpus[thread], &set);
 
-	void onSeek(sf::Time timeOffset) override {}
-};
+			int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			granted += "CPU " + std::to_string(Realtime::cpus[thread]) + (error ? std::string(" denied (") + strerror(error) + ")" : "");
+#else
+			granted += "CPU affinity unsupported";
+#endif
+		}
 
-class Video {
-public:
-	class Screen {
-	public:
-		enum Type { TOP, BOT, JOINT, SIZE };
-		enum Crop { DEFAULT_3DS, SCALED_DS, NATIVE_DS, COUNT };
+		if (Realtime::policy != SCHED_OTHER) {
+			struct sched_param param = {};
+			param.sched_priority = std::clamp(Realtime::priority - thread, sched_get_priority_min(Realtime::policy), sched_get_priority_max(Realtime::policy));
 
-		static inline const int widths[Video::Screen::Crop::COUNT] = { 400, 320, 256 };
-		static inline const int heights[Video::Screen::Crop::COUNT] = { 240, 240, 192 };
+			int error = pthread_setschedparam(pthread_self(), Realtime::policy, &param);
 
-		sf::RectangleShape m_in_rect;
-		sf::RenderWindow m_win;
+			granted += granted.empty() ? "" : ", ";
+			granted += std::string(Realtime::policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_RR") + " priority " + std::to_string(param.sched_priority) + (error ? std::string(" denied (") + strerror(error) + "), left at SCHED_OTHER" : "");
+		}
 
-		bool m_blur = false;
-		Crop m_crop = Video::Screen::Crop::DEFAULT_3DS;
-		int m_rotation = 0;
-		double m_scale = 1.0;
+		if (!granted.empty()) {
+			printf("[%s] %s thread: %s.\n", name.c_str(), p_role, granted.c_str());
+		}
+	}
 
-		Screen() {}
+	static inline UCHAR *allocate(std::size_t size) {
+		void *p_buf = MAP_FAILED;
 
-		std::string key() {
-			switch (this->m_type) {
-			case Video::Screen::Type::TOP:
-				return "top";
+#if defined(MAP_HUGETLB)
+		if (Realtime::lock) {
+			p_buf = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
 
-			case Video::Screen::Type::BOT:
-				return "bot";
+			if (p_buf != MAP_FAILED) {
+				Realtime::huge += size;
+			}
+		}
+#endif
 
-			case Video::Screen::Type::JOINT:
-				return "joint";
+		if (p_buf == MAP_FAILED) {
+			p_buf = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-			default:
-				return "";
+#if defined(MADV_HUGEPAGE)
+			if (p_buf != MAP_FAILED && Realtime::lock) {
+				madvise(p_buf, size, MADV_HUGEPAGE);
 			}
+#endif
 		}
 
-		void build(Video::Screen::Type type, int u, int width, bool visible) {
-			this->m_type = type;
+		if (p_buf == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
 
-			this->resize(Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], this->height(Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]));
+		Realtime::pin(p_buf, size);
 
-			this->m_in_rect.setTexture(&Video::in_tex);
-			this->m_in_rect.setTextureRect(sf::IntRect(0, u, this->m_height, width));
+		return static_cast<UCHAR*>(p_buf);
+	}
 
-			this->m_in_rect.setSize(sf::Vector2f(this->m_height, width));
-			this->m_in_rect.setOrigin(this->m_height / 2, width / 2);
+	static inline void free(UCHAR *p_buf, std::size_t size) {
+		munmap(p_buf, size);
+	}
 
-			this->m_in_rect.setRotation(-90);
-			this->m_in_rect.setPosition(width / 2, this->m_height / 2);
+	static inline void pin(void *p_buf, std::size_t size) {
+		if (!Realtime::lock) {
+			return;
+		}
+
+		if (mlock(p_buf, size)) {
+			Realtime::error = errno;
+			return;
+		}
 
-			this->m_out_tex.create(width, this->m_height);
+		Realtime::locked += size;
+	}
 
-			this->m_out_rect.setSize(sf::Vector2f(width, this->m_height));
-			this->m_out_rect.setTexture(&this->m_out_tex.getTexture());
+	static inline void print() {
+		if (!Realtime::lock) {
+			return;
+		}
 
-			this->m_view.reset(sf::FloatRect(0, 0, width, this->m_height));
+		printf("[%s] Locked %llu KB of buffers in memory, %llu KB in huge pages.\n", NAME, static_cast<unsigned long long>(Realtime::locked / 1024), static_cast<unsigned long long>(Realtime::huge / 1024));
 
-			if (visible) {
-				this->open();
-			}
+		if (Realtime::error) {
+			printf("[%s] Locking some buffers was denied (%s).\n", NAME, strerror(Realtime::error));
 		}
+	}
 
-		void reset() {
-			this->resize(Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], this->height(Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]));
+private:
+	static inline std::atomic<uint64_t> locked = 0;
+	static inline std::atomic<uint64_t> huge = 0;
+	static inline std::atomic<int> error = 0;
+};
 
-			this->m_view.setRotation(0);
+class Codec {
+public:
+	static_assert(BUF_SIZE % sizeof(uint64_t) == 0, "Packet size must be a multiple of the codec word size.");
 
-			this->m_view.setSize(this->m_width, this->m_height);
-			this->m_win.setView(this->m_view);
+	Codec(int threads) {
+		this->m_threads = std::clamp(threads, 1, CODEC_BANDS);
 
-			this->m_out_tex.setSmooth(this->m_blur);
+		for (int i = 0; i < CODEC_BANDS; ++i) {
+			this->m_bands[i].resize(CODEC_BOUND / CODEC_BANDS);
+		}
 
-			if (this->m_rotation) {
-				if (this->horizontal()) {
-					std::swap(this->m_width, this->m_height);
-				}
+		for (int i = 1; i < this->m_threads; ++i) {
+			this->m_workers.emplace_back(&Codec::work, this, i);
+		}
+	}
 
-				this->rotate();
-			}
+	~Codec() {
+		{
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			this->m_stopping = true;
+		}
 
-			if (this->m_crop) {
-				this->crop();
-			}
+		this->m_start.notify_all();
 
-			this->move();
+		for (auto &worker : this->m_workers) {
+			worker.join();
 		}
+	}
 
-		void move() {
-			this->m_in_rect.setPosition(this->m_in_rect.getOrigin().y, this->m_in_rect.getOrigin().x);
+	std::size_t encode(UCHAR *p_in, UCHAR *p_ref, UCHAR *p_out, bool key) {
+		this->m_in = p_in;
+		this->m_ref = p_ref;
+		this->m_key = key;
 
-			switch (this->m_type) {
-			case Video::Screen::Type::TOP:
-				if (Video::split) {
-					this->m_in_rect.move(0, (Video::Screen::heights[this->m_crop] - Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]) / 2);
-				}
+		if (this->m_threads > 1) {
+			std::unique_lock<std::mutex> lock(this->m_mutex);
 
-				return;
+			this->m_pending = this->m_threads - 1;
+			++this->m_generation;
 
-			case Video::Screen::Type::BOT:
-				if (Video::split) {
-					this->m_in_rect.move(0, (Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS] - Video::Screen::heights[this->m_crop]) / 2);
-				}
+			lock.unlock();
+			this->m_start.notify_all();
+		}
 
-				else {
-					this->m_in_rect.move((Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS] - Video::Screen::widths[Video::Screen::Crop::SCALED_DS]) / 2, Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]);
-				}
+		this->run(0);
 
-				return;
-			}
+		if (this->m_threads > 1) {
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+			this->m_done.wait(lock, [&] { return !this->m_pending; });
 		}
 
-		void poll() {
-			while (this->m_win.pollEvent(this->m_event)) {
-				switch (this->m_event.type) {
-				case sf::Event::Closed:
-					g_running = false;
-					break;
+		std::size_t size = CODEC_BANDS * sizeof(uint32_t);
+
+		for (int i = 0; i < CODEC_BANDS; ++i) {
+			uint32_t band = this->m_sizes[i];
 
-				case sf::Event::KeyPressed:
-					switch (this->m_event.key.code) {
-					case sf::Keyboard::Dash:
-						Video::brightness = Video::brightness > 55 ? Video::brightness / 5 * 5 - 5 : 50;
-						break;
+			memcpy(&p_out[i * sizeof(uint32_t)], &band, sizeof(uint32_t));
+			memcpy(&p_out[size], this->m_bands[i].data(), band);
 
-					case sf::Keyboard::Equal:
-						Video::brightness = Video::brightness < 145 ? Video::brightness / 5 * 5 + 5 : 150;
-						break;
+			size += band;
+		}
 
-					case sf::Keyboard::Down:
-						this->m_scale = this->m_scale > 1.5 ? static_cast<int>(this->m_scale / 0.5) * 0.5 - 0.5 : 1.0;
-						break;
+		memcpy(p_ref, p_in, BUF_SIZE);
 
-					case sf::Keyboard::Up:
-						this->m_scale = this->m_scale < 4.0 ? static_cast<int>(this->m_scale / 0.5) * 0.5 + 0.5 : 4.5;
-						break;
+		return size;
+	}
 
-					case sf::Keyboard::Left:
-						std::swap(this->m_width, this->m_height);
+	static inline bool decode(UCHAR *p_in, std::size_t size, bool key, UCHAR *p_frame) {
+		std::size_t offset = CODEC_BANDS * sizeof(uint32_t);
 
-						this->m_rotation = ((this->m_rotation / 90 * 90 + 90) % 360 + 360) % 360;
-						this->rotate();
+		if (size < offset) {
+			return false;
+		}
 
-						break;
+		for (int i = 0; i < CODEC_BANDS; ++i) {
+			uint32_t band;
+			memcpy(&band, &p_in[i * sizeof(uint32_t)], sizeof(uint32_t));
 
-					case sf::Keyboard::Right:
-						std::swap(this->m_width, this->m_height);
+			if (band > size - offset || !Codec::unpack(&p_in[offset], band, key, p_frame, CODEC_WORDS * i / CODEC_BANDS, CODEC_WORDS * (i + 1) / CODEC_BANDS)) {
+				return false;
+			}
 
-						this->m_rotation = ((this->m_rotation / 90 * 90 - 90) % 360 + 360) % 360;
-						this->rotate();
+			offset += band;
+		}
 
-						break;
+		if (key) {
+			for (int i = CODEC_STRIDE; i < CODEC_WORDS; ++i) {
+				Codec::store(p_frame, i, Codec::load(p_frame, i) ^ Codec::load(p_frame, i - CODEC_STRIDE));
+			}
+		}
 
-					case sf::Keyboard::LBracket:
-						this->m_crop = static_cast<Crop>(((this->m_crop - 1) % Video::Screen::Crop::COUNT + Video::Screen::Crop::COUNT) % Video::Screen::Crop::COUNT);
+		return offset == size;
+	}
 
-						this->crop();
-						this->move();
+private:
+	std::vector<UCHAR> m_bands[CODEC_BANDS];
+	std::size_t m_sizes[CODEC_BANDS];
 
-						break;
+	std::vector<std::thread> m_workers;
+	int m_threads;
 
-					case sf::Keyboard::RBracket:
-						this->m_crop = static_cast<Crop>(((this->m_crop + 1) % Video::Screen::Crop::COUNT + Video::Screen::Crop::COUNT) % Video::Screen::Crop::COUNT);
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
 
-						this->crop();
-						this->move();
+	uint64_t m_generation = 0;
+	int m_pending = 0;
+	bool m_stopping = false;
 
-						break;
+	UCHAR *m_in;
+	UCHAR *m_ref;
+	bool m_key;
 
-					case sf::Keyboard::Comma:
-						Audio::volume = Audio::volume > 5 ? Audio::volume / 5 * 5 - 5 : 0;
-						Audio::adjust();
+	static inline uint64_t load(UCHAR *p_buf, int index) {
+		uint64_t word;
+		memcpy(&word, &p_buf[index * sizeof(uint64_t)], sizeof(uint64_t));
 
-						break;
+		return word;
+	}
 
-					case sf::Keyboard::Period:
-						Audio::volume = Audio::volume < 95 ? Audio::volume / 5 * 5 + 5 : 100;
-						Audio::adjust();
+	static inline void store(UCHAR *p_buf, int index, uint64_t word) {
+		memcpy(&p_buf[index * sizeof(uint64_t)], &word, sizeof(uint64_t));
+	}
 
-						break;
-					}
+	static inline void pack(UCHAR **pp_out, uint32_t value) {
+		while (value >= 0x80) {
+			*(*pp_out)++ = value | 0x80;
+			value >>= 7;
+		}
 
-					break;
+		*(*pp_out)++ = value;
+	}
 
-				case sf::Event::KeyReleased:
-					switch (this->m_event.key.code) {
-					case sf::Keyboard::Escape:
-						if (!Capture::auto_connect) {
-							Capture::connected ? Capture::disconnecting = true : Capture::connected = Capture::connect();
-						}
+	static inline bool unpack(UCHAR **pp_in, UCHAR *p_end, uint32_t *p_value) {
+		*p_value = 0;
 
-						break;
-
-					case sf::Keyboard::Num0:
-						Video::brightness = 100;
-						break;
-
-					case sf::Keyboard::Tab:
-						Video::split ^= true;
-						Video::swap();
-
-						break;
-
-					case sf::Keyboard::B:
-						this->m_out_tex.setSmooth(this->m_blur ^= true);
-						break;
-
-					case sf::Keyboard::M:
-						Audio::mute ^= true;
-						Audio::adjust();
-
-						break;
-
-					case sf::Keyboard::F1:
-					case sf::Keyboard::F2:
-					case sf::Keyboard::F3:
-					case sf::Keyboard::F4:
-					case sf::Keyboard::F5:
-					case sf::Keyboard::F6:
-					case sf::Keyboard::F7:
-					case sf::Keyboard::F8:
-					case sf::Keyboard::F9:
-					case sf::Keyboard::F10:
-					case sf::Keyboard::F11:
-					case sf::Keyboard::F12:
-						if (!g_safe_mode) {
-							if (this->m_event.key.control) {
-								Video::p_save(CONF_DIR + "presets/", "layout" + std::to_string(this->m_event.key.code - sf::Keyboard::F1 + 1) + ".conf");
-							}
-
-							else {
-								Video::p_load(CONF_DIR + "presets/", "layout" + std::to_string(this->m_event.key.code - sf::Keyboard::F1 + 1) + ".conf");
-
-								Audio::adjust();
-								Video::init();
-							}
-						}
+		for (int shift = 0; shift < 32; shift += 7) {
+			if (*pp_in == p_end) {
+				return false;
+			}
 
-						break;
-					}
+			UCHAR byte = *(*pp_in)++;
+			*p_value |= static_cast<uint32_t>(byte & 0x7f) << shift;
 
-					break;
-				}
+			if (!(byte & 0x80)) {
+				return true;
 			}
 		}
 
-		void toggle() {
-			this->m_win.isOpen() ? this->m_win.close() : this->open();
+		return false;
+	}
+
+	static inline bool unpack(UCHAR *p_in, std::size_t size, bool key, UCHAR *p_frame, int begin, int end) {
+		UCHAR *p_end = p_in + size;
+
+		for (int i = begin; i < end;) {
+			uint32_t zeros, literals;
+
+			if (!Codec::unpack(&p_in, p_end, &zeros) || !Codec::unpack(&p_in, p_end, &literals) || zeros > static_cast<uint32_t>(end - i) || literals > static_cast<uint32_t>(end - i) - zeros || static_cast<std::size_t>(p_end - p_in) < literals * sizeof(uint64_t)) {
+				return false;
+			}
+
+			if (key) {
+				memset(&p_frame[i * sizeof(uint64_t)], 0x00, zeros * sizeof(uint64_t));
+			}
+
+			i += zeros;
+
+			for (uint32_t j = 0; j < literals; ++j, ++i, p_in += sizeof(uint64_t)) {
+				Codec::store(p_frame, i, key ? Codec::load(p_in, 0) : Codec::load(p_frame, i) ^ Codec::load(p_in, 0));
+			}
+		}
+
+		return p_in == p_end;
+	}
+
+	uint64_t delta(int index) {
+		if (this->m_key) {
+			return Codec::load(this->m_in, index) ^ (index < CODEC_STRIDE ? 0 : Codec::load(this->m_in, index - CODEC_STRIDE));
+		}
+
+		return Codec::load(this->m_in, index) ^ Codec::load(this->m_ref, index);
+	}
+
+	void pack(int band) {
+		int end = CODEC_WORDS * (band + 1) / CODEC_BANDS;
+		UCHAR *p_out = this->m_bands[band].data();
+
+		for (int i = CODEC_WORDS * band / CODEC_BANDS; i < end;) {
+			int zeros = i;
+
+			while (i < end && !this->delta(i)) {
+				++i;
+			}
+
+			int literals = i;
+
+			while (i < end && (this->delta(i) || (i + 1 < end && this->delta(i + 1)))) {
+				++i;
+			}
+
+			Codec::pack(&p_out, literals - zeros);
+			Codec::pack(&p_out, i - literals);
+
+			for (int j = literals; j < i; ++j, p_out += sizeof(uint64_t)) {
+				Codec::store(p_out, 0, this->delta(j));
+			}
+		}
+
+		this->m_sizes[band] = p_out - this->m_bands[band].data();
+	}
+
+	void run(int thread) {
+		for (int i = thread; i < CODEC_BANDS; i += this->m_threads) {
+			this->pack(i);
+		}
+	}
+
+	void work(int thread) {
+		uint64_t generation = 0;
+
+		while (true) {
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+			this->m_start.wait(lock, [&] { return this->m_stopping || this->m_generation != generation; });
+
+			if (this->m_stopping) {
+				return;
+			}
+
+			generation = this->m_generation;
+			lock.unlock();
+
+			this->run(thread);
+			lock.lock();
+
+			if (!--this->m_pending) {
+				this->m_done.notify_one();
+			}
+		}
+	}
+};
+
+class Recorder {
+public:
+	struct Header {
+		char magic[8];
+
+		uint32_t version;
+		uint32_t codec;
+
+		uint32_t width;
+		uint32_t height;
+
+		uint32_t sample_rate;
+		uint32_t channels;
+
+		uint32_t size;
+		uint32_t reserved;
+	};
+
+	struct Packet {
+		uint32_t size;
+		uint32_t read;
+
+		uint64_t sequence;
+		int64_t time;
+
+		uint32_t flags;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(Recorder::Packet) == RECORD_HEADER, "Packet header size mismatch.");
+
+	static inline std::string dir;
+	static inline bool compress = false;
+
+	static inline std::atomic<bool> active = false;
+	static inline std::atomic<int> device = 0;
+
+	static inline std::atomic<uint64_t> written = 0;
+	static inline std::atomic<uint64_t> dropped = 0;
+
+	static inline bool valid(Recorder::Header *p_header) {
+		return memcmp(p_header->magic, NAME, sizeof(p_header->magic)) == 0 && p_header->width == CAP_WIDTH && p_header->height == CAP_HEIGHT && p_header->size == BUF_SIZE;
+	}
+
+	static inline void toggle(int device) {
+		if (Recorder::active) {
+			Recorder::active = false;
+			return;
+		}
+
+		if (Recorder::writing) {
+			printf("[%s] Recording still finishing.\n", NAME);
+			return;
+		}
+
+		if (Recorder::thread.joinable()) {
+			Recorder::thread.join();
+		}
+
+		if (!Recorder::p_pool) {
+			Recorder::p_pool = static_cast<UCHAR*>(std::aligned_alloc(RECORD_ALIGN, static_cast<std::size_t>(RECORD_COUNT) * RECORD_SIZE));
+
+			for (int i = 0; i < RECORD_COUNT; ++i) {
+				Recorder::empty.push(i);
+			}
+		}
+
+		char time[32];
+		std::time_t now = std::time(nullptr);
+		std::strftime(time, sizeof(time), "%Y%m%d-%H%M%S", std::localtime(&now));
+
+		Recorder::written = 0;
+		Recorder::dropped = 0;
+
+		Recorder::device = device;
+		Recorder::stopped = false;
+
+		Recorder::active = true;
+		Recorder::writing = true;
+		Recorder::thread = std::thread(Recorder::write, Recorder::dir + NAME + "-" + (device ? std::to_string(device) + "-" : "") + time + ".rec");
+	}
+
+	static inline void push(UCHAR *p_buf, ULONG read, uint64_t sequence, int64_t time) {
+		if (!Recorder::active) {
+			Recorder::flush();
+			return;
+		}
+
+		int slot;
+
+		if (!Recorder::empty.pop(&slot)) {
+			++Recorder::dropped;
+			return;
+		}
+
+		Recorder::Packet *p_packet = reinterpret_cast<Recorder::Packet*>(&Recorder::p_pool[static_cast<std::size_t>(slot) * RECORD_SIZE]);
+		*p_packet = { RECORD_SIZE - RECORD_HEADER, static_cast<uint32_t>(read), sequence, time, 0, 0 };
+
+		memcpy(reinterpret_cast<UCHAR*>(p_packet) + RECORD_HEADER, p_buf, BUF_SIZE);
+		Recorder::full.push(slot);
+	}
+
+	static inline bool verify(std::string path) {
+		std::ifstream file(path, std::ios::binary);
+		Recorder::Header header = {};
+
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !Recorder::valid(&header) || !file.seekg(RECORD_ALIGN)) {
+			printf("[%s] File \"%s\" is not a recording.\n", NAME, path.c_str());
+			return false;
+		}
+
+		Codec codec(1);
+
+		std::vector<UCHAR> payload;
+		std::vector<UCHAR> frame(BUF_SIZE);
+		std::vector<UCHAR> ref(BUF_SIZE);
+		std::vector<UCHAR> out(CODEC_BOUND);
+		std::vector<UCHAR> check(BUF_SIZE);
+
+		uint64_t frames = 0;
+		uint64_t failures = 0;
+
+		std::size_t raw = 0;
+		std::size_t packed = 0;
+
+		sf::Int64 encoding = 0;
+		sf::Int64 decoding = 0;
+
+		Recorder::Packet packet;
+
+		while (file.read(reinterpret_cast<char*>(&packet), sizeof(packet))) {
+			payload.resize(packet.size);
+
+			if (!file.read(reinterpret_cast<char*>(payload.data()), packet.size)) {
+				printf("[%s] Packet %llu is truncated.\n", NAME, static_cast<unsigned long long>(frames));
+
+				++failures;
+				break;
+			}
+
+			bool key = header.codec == RECORD_RAW ? frames % CODEC_KEYFRAME == 0 : packet.flags & RECORD_KEYFRAME;
+
+			if (header.codec == RECORD_RAW) {
+				if (packet.size < BUF_SIZE) {
+					++failures;
+					break;
+				}
+
+				memcpy(frame.data(), payload.data(), BUF_SIZE);
+			}
+
+			else {
+				memcpy(check.data(), ref.data(), BUF_SIZE);
+				auto start = std::chrono::steady_clock::now();
+
+				if (!Codec::decode(payload.data(), packet.size, key, check.data())) {
+					printf("[%s] Packet %llu failed to decode.\n", NAME, static_cast<unsigned long long>(frames));
+
+					++failures;
+					break;
+				}
+
+				decoding += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+				memcpy(frame.data(), check.data(), BUF_SIZE);
+			}
+
+			memcpy(check.data(), ref.data(), BUF_SIZE);
+			auto start = std::chrono::steady_clock::now();
+
+			std::size_t size = codec.encode(frame.data(), ref.data(), out.data(), key);
+			encoding += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+			if (header.codec == RECORD_RAW) {
+				start = std::chrono::steady_clock::now();
+
+				if (!Codec::decode(out.data(), size, key, check.data()) || memcmp(check.data(), frame.data(), BUF_SIZE)) {
+					printf("[%s] Packet %llu failed to round trip.\n", NAME, static_cast<unsigned long long>(frames));
+					++failures;
+				}
+
+				decoding += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			else if (size != packet.size || memcmp(out.data(), payload.data(), size)) {
+				printf("[%s] Packet %llu failed to round trip.\n", NAME, static_cast<unsigned long long>(frames));
+				++failures;
+			}
+
+			raw += BUF_SIZE;
+			packed += size;
+
+			++frames;
+		}
+
+		if (frames) {
+			printf("[%s] Verified %llu packets, %llu failed, %.1f%% of raw size, %lld us/frame encode, %lld us/frame decode.\n", NAME, static_cast<unsigned long long>(frames), static_cast<unsigned long long>(failures), packed * 100.0 / raw, static_cast<long long>(encoding / frames), static_cast<long long>(decoding / frames));
+		}
+
+		return frames && !failures;
+	}
+
+	static inline void flush() {
+		if (Recorder::writing && !Recorder::active && !Recorder::stopped) {
+			Recorder::stopped = true;
+			Recorder::full.push(RECORD_STOP);
+		}
+	}
+
+	static inline void close() {
+		Recorder::active = false;
+		Recorder::flush();
+
+		if (Recorder::thread.joinable()) {
+			Recorder::thread.join();
+		}
+
+		std::free(Recorder::p_pool);
+		Recorder::p_pool = nullptr;
+	}
+
+private:
+	static inline UCHAR *p_pool;
+
+	static inline Queue<int, RECORD_COUNT> empty;
+	static inline Queue<int, RECORD_COUNT * 2> full;
+
+	static inline std::thread thread;
+	static inline std::atomic<bool> writing = false;
+
+	static inline bool stopped = false;
+
+	static inline void write(std::string path) {
+		std::filesystem::create_directories(Recorder::dir);
+		int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (fd < 0) {
+			printf("[%s] File \"%s\" open failed.\n", NAME, path.c_str());
+		}
+
+		else {
+			printf("[%s] Recording to \"%s\".\n", NAME, path.c_str());
+		}
+
+		UCHAR *p_header = static_cast<UCHAR*>(std::aligned_alloc(RECORD_ALIGN, RECORD_ALIGN));
+		memset(p_header, 0x00, RECORD_ALIGN);
+
+		*reinterpret_cast<Recorder::Header*>(p_header) = { {}, RECORD_VERSION, static_cast<uint32_t>(Recorder::compress ? RECORD_DELTA : RECORD_RAW), CAP_WIDTH, CAP_HEIGHT, SAMPLE_RATE, AUDIO_CHANNELS, BUF_SIZE, 0 };
+		memcpy(reinterpret_cast<Recorder::Header*>(p_header)->magic, NAME, sizeof(Recorder::Header::magic));
+
+		if (fd >= 0 && ::write(fd, p_header, RECORD_ALIGN) != RECORD_ALIGN) {
+			printf("[%s] File \"%s\" write failed.\n", NAME, path.c_str());
+
+			::close(fd);
+			fd = -1;
+		}
+
+		std::free(p_header);
+
+		Codec *p_codec = nullptr;
+
+		UCHAR *p_ref = nullptr;
+		UCHAR *p_stage = nullptr;
+
+		uint64_t frames = 0;
+
+		if (Recorder::compress) {
+			p_codec = new Codec(std::thread::hardware_concurrency());
+
+			p_ref = new UCHAR[BUF_SIZE];
+			p_stage = static_cast<UCHAR*>(std::aligned_alloc(RECORD_ALIGN, RECORD_STAGE));
+		}
+
+		bool stopping = false;
+
+		while (!stopping) {
+			int slots[RECORD_BATCH];
+			struct iovec iov[RECORD_BATCH];
+
+			int count = 0;
+			int slot;
+
+			Recorder::full.wait(&slot);
+
+			do {
+				if (slot == RECORD_STOP) {
+					stopping = true;
+					break;
+				}
+
+				slots[count] = slot;
+				iov[count] = { &Recorder::p_pool[static_cast<std::size_t>(slot) * RECORD_SIZE], RECORD_SIZE };
+
+				++count;
+			} while (count < RECORD_BATCH && Recorder::full.pop(&slot));
+
+			std::size_t size = static_cast<std::size_t>(count) * RECORD_SIZE;
+
+			if (p_codec) {
+				size = 0;
+
+				for (int i = 0; i < count; ++i) {
+					Recorder::Packet *p_packet = reinterpret_cast<Recorder::Packet*>(&p_stage[size]);
+					*p_packet = *static_cast<Recorder::Packet*>(iov[i].iov_base);
+
+					p_packet->flags = frames++ % CODEC_KEYFRAME ? 0 : RECORD_KEYFRAME;
+					p_packet->size = p_codec->encode(static_cast<UCHAR*>(iov[i].iov_base) + RECORD_HEADER, p_ref, &p_stage[size + RECORD_HEADER], p_packet->flags & RECORD_KEYFRAME);
+
+					size += RECORD_HEADER + p_packet->size;
+					Recorder::empty.push(slots[i]);
+				}
+
+				iov[0] = { p_stage, size };
+			}
+
+			if (count && fd >= 0) {
+				if (::writev(fd, iov, p_codec ? 1 : count) == static_cast<ssize_t>(size)) {
+					Recorder::written += count;
+				}
+
+				else {
+					printf("[%s] File \"%s\" write failed.\n", NAME, path.c_str());
+
+					::close(fd);
+					fd = -1;
+				}
+			}
+
+			if (fd < 0) {
+				Recorder::dropped += count;
+			}
+
+			if (!p_codec) {
+				for (int i = 0; i < count; ++i) {
+					Recorder::empty.push(slots[i]);
+				}
+			}
+		}
+
+		delete p_codec;
+		delete[] p_ref;
+
+		std::free(p_stage);
+
+		if (fd >= 0) {
+			::close(fd);
+		}
+
+		printf("[%s] Recording stopped, %llu written, %llu dropped.\n", NAME, static_cast<unsigned long long>(Recorder::written), static_cast<unsigned long long>(Recorder::dropped));
+		Recorder::writing = false;
+	}
+};
+
+class Soundtrack {
+public:
+	struct Packet {
+		uint32_t size;
+		uint32_t reserved;
+
+		uint64_t sequence;
+		int64_t time;
+	};
+
+	struct Gap {
+		uint64_t start;
+		uint64_t length;
+	};
+
+	static_assert(sizeof(Soundtrack::Packet) == SOUND_HEADER, "Packet header size mismatch.");
+
+	static inline bool flac = false;
+
+	static inline std::atomic<bool> active = false;
+	static inline std::atomic<int> device = 0;
+
+	static inline std::atomic<uint64_t> written = 0;
+	static inline std::atomic<uint64_t> silent = 0;
+	static inline std::atomic<uint64_t> gaps = 0;
+	static inline std::atomic<uint64_t> dropped = 0;
+
+	static inline void toggle(int device) {
+		if (Soundtrack::active) {
+			Soundtrack::active = false;
+			return;
+		}
+
+		if (Soundtrack::writing) {
+			printf("[%s] Audio recording still finishing.\n", NAME);
+			return;
+		}
+
+		if (Soundtrack::thread.joinable()) {
+			Soundtrack::thread.join();
+		}
+
+		if (!Soundtrack::p_pool) {
+			Soundtrack::p_pool = static_cast<UCHAR*>(std::malloc(static_cast<std::size_t>(SOUND_COUNT) * SOUND_SIZE));
+
+			for (int i = 0; i < SOUND_COUNT; ++i) {
+				Soundtrack::empty.push(i);
+			}
+		}
+
+		char time[32];
+		std::time_t now = std::time(nullptr);
+		std::strftime(time, sizeof(time), "%Y%m%d-%H%M%S", std::localtime(&now));
+
+		Soundtrack::written = 0;
+		Soundtrack::silent = 0;
+		Soundtrack::gaps = 0;
+		Soundtrack::dropped = 0;
+
+		Soundtrack::device = device;
+		Soundtrack::stopped = false;
+
+		Soundtrack::active = true;
+		Soundtrack::writing = true;
+		Soundtrack::thread = std::thread(Soundtrack::write, Recorder::dir + NAME + "-" + (device ? std::to_string(device) + "-" : "") + time + (Soundtrack::flac ? ".flac" : ".wav"));
+	}
+
+	static inline void push(UCHAR *p_buf, ULONG read, uint64_t sequence, int64_t time, bool starting) {
+		if (!Soundtrack::active) {
+			Soundtrack::flush();
+			return;
+		}
+
+		int slot;
+
+		if (!Soundtrack::empty.pop(&slot)) {
+			++Soundtrack::dropped;
+			return;
+		}
+
+		uint32_t size = starting || read <= FRAME_SIZE_RGB ? 0 : std::min<ULONG>(read - FRAME_SIZE_RGB, SAMPLE_SIZE_8) / 2 / AUDIO_CHANNELS * 2 * AUDIO_CHANNELS;
+
+		Soundtrack::Packet *p_packet = reinterpret_cast<Soundtrack::Packet*>(&Soundtrack::p_pool[static_cast<std::size_t>(slot) * SOUND_SIZE]);
+		*p_packet = { size, 0, sequence, time };
+
+		memcpy(reinterpret_cast<UCHAR*>(p_packet) + SOUND_HEADER, &p_buf[FRAME_SIZE_RGB], size);
+		Soundtrack::full.push(slot);
+	}
+
+	static inline void flush() {
+		if (Soundtrack::writing && !Soundtrack::active && !Soundtrack::stopped) {
+			Soundtrack::stopped = true;
+			Soundtrack::full.push(SOUND_STOP);
+		}
+	}
+
+	static inline void close() {
+		Soundtrack::active = false;
+		Soundtrack::flush();
+
+		if (Soundtrack::thread.joinable()) {
+			Soundtrack::thread.join();
+		}
+
+		std::free(Soundtrack::p_pool);
+		Soundtrack::p_pool = nullptr;
+	}
+
+	static inline void bench() {
+		sf::Int16 in[SOUND_BLOCK * AUDIO_CHANNELS];
+		std::vector<UCHAR> out(SOUND_BOUND);
+
+		for (int i = 0; i < SOUND_BLOCK; ++i) {
+			in[i * 2] = std::sin(i * 2.0 * M_PI * 440.0 / SAMPLE_RATE) * 8192.0 + static_cast<int>(i * 2654435761u >> 28) - 8;
+			in[i * 2 + 1] = std::sin(i * 2.0 * M_PI * 660.0 / SAMPLE_RATE) * 8192.0 + static_cast<int>(i * 2246822519u >> 28) - 8;
+		}
+
+		std::size_t size = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < BENCH_COUNT / 10; ++i) {
+			size = Soundtrack::encode(in, SOUND_BLOCK, i, out.data());
+		}
+
+		auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		Bench::record("sound.flac", time / (BENCH_COUNT / 10), "ns/block", size < sizeof(in));
+	}
+
+private:
+	enum Subframe {
+		CONSTANT,
+		VERBATIM,
+		FIXED,
+	};
+
+	struct Choice {
+		Soundtrack::Subframe type;
+		int order;
+		uint64_t bits;
+	};
+
+	class Bits {
+	public:
+		Bits(UCHAR *p_out) {
+			this->m_out = p_out;
+		}
+
+		void put(uint32_t value, int width) {
+			this->m_bits = this->m_bits << width | (value & ((1ull << width) - 1));
+			this->m_count += width;
+
+			while (this->m_count >= 8) {
+				this->m_count -= 8;
+				this->m_out[this->m_size++] = this->m_bits >> this->m_count;
+			}
+		}
+
+		void rice(uint32_t value, int k) {
+			uint32_t quotient = value >> k;
+
+			for (; quotient + k + 1 > 32; quotient -= 16) {
+				this->put(0, 16);
+			}
+
+			this->put(1u << k | (value & ((1u << k) - 1)), quotient + k + 1);
+		}
+
+		void align() {
+			if (this->m_count) {
+				this->put(0, 8 - this->m_count);
+			}
+		}
+
+		std::size_t size() {
+			return this->m_size;
+		}
+
+	private:
+		UCHAR *m_out;
+		std::size_t m_size = 0;
+
+		uint64_t m_bits = 0;
+		int m_count = 0;
+	};
+
+	static inline UCHAR *p_pool;
+
+	static inline Queue<int, SOUND_COUNT> empty;
+	static inline Queue<int, SOUND_COUNT * 2> full;
+
+	static inline std::thread thread;
+	static inline std::atomic<bool> writing = false;
+
+	static inline bool stopped = false;
+
+	static inline int fd = -1;
+	static inline std::string path;
+
+	static inline sf::Int16 stage[SOUND_BLOCK * AUDIO_CHANNELS];
+	static inline int staged = 0;
+
+	static inline uint64_t frames = 0;
+	static inline uint32_t blocks = 0;
+	static inline double owed = 0.0;
+
+	static inline uint32_t smallest = 0;
+	static inline uint32_t largest = 0;
+
+	static inline std::vector<Soundtrack::Gap> markers;
+	static inline std::vector<UCHAR> out;
+
+	static inline int32_t channels[4][SOUND_BLOCK];
+	static inline int32_t residual[SOUND_BLOCK];
+	static inline uint32_t folded[SOUND_BLOCK];
+	static inline int params[1 << SOUND_PARTITION];
+
+	static inline void write(std::string path) {
+		std::filesystem::create_directories(Recorder::dir);
+
+		Soundtrack::path = path;
+		Soundtrack::fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		Soundtrack::staged = 0;
+		Soundtrack::frames = 0;
+		Soundtrack::blocks = 0;
+		Soundtrack::owed = 0.0;
+
+		Soundtrack::smallest = 0;
+		Soundtrack::largest = 0;
+
+		Soundtrack::markers.clear();
+		Soundtrack::out.resize(SOUND_BOUND);
+
+		if (Soundtrack::fd < 0) {
+			printf("[%s] File \"%s\" open failed.\n", NAME, path.c_str());
+		}
+
+		else {
+			printf("[%s] Recording audio to \"%s\".\n", NAME, path.c_str());
+			std::vector<UCHAR> header = Soundtrack::header(false);
+
+			if (::write(Soundtrack::fd, header.data(), header.size()) != static_cast<ssize_t>(header.size())) {
+				Soundtrack::fail();
+			}
+		}
+
+		bool stopping = false;
+		bool started = false;
+
+		uint64_t sequence = 0;
+		int64_t time = 0;
+
+		while (!stopping) {
+			int slots[SOUND_BATCH];
+
+			int count = 0;
+			int slot;
+
+			Soundtrack::full.wait(&slot);
+
+			do {
+				if (slot == SOUND_STOP) {
+					stopping = true;
+					break;
+				}
+
+				slots[count++] = slot;
+			} while (count < SOUND_BATCH && Soundtrack::full.pop(&slot));
+
+			for (int i = 0; i < count; ++i) {
+				Soundtrack::Packet *p_packet = reinterpret_cast<Soundtrack::Packet*>(&Soundtrack::p_pool[static_cast<std::size_t>(slots[i]) * SOUND_SIZE]);
+
+				if (started) {
+					int64_t missing = static_cast<int64_t>(p_packet->sequence - sequence) - 1;
+					double late = (p_packet->time - time) * FRAME_RATE / 1000000.0;
+
+					if (late > SOUND_LATE) {
+						missing = std::max<int64_t>(missing, std::llround(late) - 1);
+					}
+
+					if (missing > 0) {
+						Soundtrack::silence(missing);
+					}
+				}
+
+				started = true;
+
+				sequence = p_packet->sequence;
+				time = p_packet->time;
+
+				if (p_packet->size) {
+					Soundtrack::append(reinterpret_cast<UCHAR*>(p_packet) + SOUND_HEADER, p_packet->size / 2 / AUDIO_CHANNELS);
+				}
+
+				else {
+					Soundtrack::silence(1);
+				}
+
+				Soundtrack::empty.push(slots[i]);
+			}
+		}
+
+		Soundtrack::emit();
+
+		if (Soundtrack::fd >= 0) {
+			std::vector<UCHAR> header = Soundtrack::header(true);
+
+			if (!Soundtrack::flac && !Soundtrack::markers.empty()) {
+				std::vector<UCHAR> trailer = Soundtrack::trailer();
+
+				if (::pwrite(Soundtrack::fd, trailer.data(), trailer.size(), header.size() + Soundtrack::frames * 2 * AUDIO_CHANNELS) != static_cast<ssize_t>(trailer.size())) {
+					Soundtrack::fail();
+				}
+			}
+
+			if (Soundtrack::fd >= 0 && ::pwrite(Soundtrack::fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+				Soundtrack::fail();
+			}
+
+			if (Soundtrack::fd >= 0) {
+				::close(Soundtrack::fd);
+				Soundtrack::fd = -1;
+			}
+		}
+
+		printf("[%s] Audio recording stopped, %.1f seconds written, %llu gaps of %.1f seconds filled, %llu dropped.\n", NAME, static_cast<double>(Soundtrack::written) / SAMPLE_RATE, static_cast<unsigned long long>(Soundtrack::gaps), static_cast<double>(Soundtrack::silent) / SAMPLE_RATE, static_cast<unsigned long long>(Soundtrack::dropped));
+		Soundtrack::writing = false;
+	}
+
+	static inline void fail() {
+		printf("[%s] File \"%s\" write failed.\n", NAME, Soundtrack::path.c_str());
+
+		::close(Soundtrack::fd);
+		Soundtrack::fd = -1;
+	}
+
+	static inline void append(UCHAR *p_in, int count) {
+		while (count) {
+			int size = std::min(count, SOUND_BLOCK - Soundtrack::staged);
+			sf::Int16 *p_out = &Soundtrack::stage[Soundtrack::staged * AUDIO_CHANNELS];
+
+			for (int i = 0; i < size * AUDIO_CHANNELS; ++i) {
+				p_out[i] = p_in[i * 2 + 1] << 8 | p_in[i * 2];
+			}
+
+			p_in += size * 2 * AUDIO_CHANNELS;
+			count -= size;
+
+			if ((Soundtrack::staged += size) == SOUND_BLOCK) {
+				Soundtrack::emit();
+			}
+		}
+	}
+
+	static inline void silence(int64_t packets) {
+		Soundtrack::owed += packets * SAMPLE_RATE / FRAME_RATE;
+
+		int64_t count = static_cast<int64_t>(Soundtrack::owed);
+		Soundtrack::owed -= count;
+
+		if (!count) {
+			return;
+		}
+
+		uint64_t start = Soundtrack::frames + Soundtrack::staged;
+
+		if (!Soundtrack::markers.empty() && Soundtrack::markers.back().start + Soundtrack::markers.back().length == start) {
+			Soundtrack::markers.back().length += count;
+		}
+
+		else {
+			Soundtrack::markers.push_back({ start, static_cast<uint64_t>(count) });
+			++Soundtrack::gaps;
+		}
+
+		Soundtrack::silent += count;
+
+		while (count) {
+			int size = std::min<int64_t>(count, SOUND_BLOCK - Soundtrack::staged);
+			memset(&Soundtrack::stage[Soundtrack::staged * AUDIO_CHANNELS], 0x00, size * 2 * AUDIO_CHANNELS);
+
+			count -= size;
+
+			if ((Soundtrack::staged += size) == SOUND_BLOCK) {
+				Soundtrack::emit();
+			}
+		}
+	}
+
+	static inline void emit() {
+		int count = Soundtrack::staged;
+		Soundtrack::staged = 0;
+
+		if (!count || Soundtrack::fd < 0) {
+			return;
+		}
+
+		UCHAR *p_data = reinterpret_cast<UCHAR*>(Soundtrack::stage);
+		std::size_t size = static_cast<std::size_t>(count) * 2 * AUDIO_CHANNELS;
+
+		if (Soundtrack::flac) {
+			size = Soundtrack::encode(Soundtrack::stage, count, Soundtrack::blocks, Soundtrack::out.data());
+			p_data = Soundtrack::out.data();
+
+			Soundtrack::smallest = Soundtrack::smallest ? std::min<uint32_t>(Soundtrack::smallest, size) : size;
+			Soundtrack::largest = std::max<uint32_t>(Soundtrack::largest, size);
+		}
+
+		else if ((Soundtrack::frames + count) * 2 * AUDIO_CHANNELS > SOUND_LIMIT) {
+			if (Soundtrack::active) {
+				printf("[%s] File \"%s\" reached the WAV size limit.\n", NAME, Soundtrack::path.c_str());
+				Soundtrack::active = false;
+			}
+
+			return;
+		}
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+		else {
+			for (int i = 0; i < count * AUDIO_CHANNELS; ++i) {
+				Soundtrack::out[i * 2] = Soundtrack::stage[i];
+				Soundtrack::out[i * 2 + 1] = Soundtrack::stage[i] >> 8;
+			}
+
+			p_data = Soundtrack::out.data();
+		}
+#endif
+
+		if (::write(Soundtrack::fd, p_data, size) != static_cast<ssize_t>(size)) {
+			Soundtrack::fail();
+			return;
+		}
+
+		Soundtrack::frames += count;
+		Soundtrack::written += count;
+
+		if (++Soundtrack::blocks % SOUND_SYNC == 0) {
+			std::vector<UCHAR> header = Soundtrack::header(false);
+
+			if (::pwrite(Soundtrack::fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+				Soundtrack::fail();
+			}
+		}
+	}
+
+	static inline std::vector<UCHAR> header(bool final) {
+		std::vector<UCHAR> data;
+
+		auto put = [&](uint32_t value, int bytes) {
+			for (int i = 0; i < bytes; ++i) {
+				data.push_back(value >> i * 8);
+			}
+		};
+
+		auto tag = [&](const char *p_tag) {
+			data.insert(data.end(), p_tag, p_tag + strlen(p_tag));
+		};
+
+		auto block = [&](bool last, int type, uint32_t size) {
+			data.push_back(last << 7 | type);
+			data.push_back(size >> 16);
+			data.push_back(size >> 8);
+			data.push_back(size);
+		};
+
+		if (!Soundtrack::flac) {
+			uint32_t size = Soundtrack::frames * 2 * AUDIO_CHANNELS;
+			uint32_t trailer = final && !Soundtrack::markers.empty() ? Soundtrack::trailer().size() : 0;
+
+			tag("RIFF");
+			put(36 + size + trailer, 4);
+			tag("WAVE");
+
+			tag("fmt ");
+			put(16, 4);
+			put(1, 2);
+			put(AUDIO_CHANNELS, 2);
+			put(SAMPLE_RATE, 4);
+			put(SAMPLE_RATE * 2 * AUDIO_CHANNELS, 4);
+			put(2 * AUDIO_CHANNELS, 2);
+			put(16, 2);
+
+			tag("data");
+			put(size, 4);
+
+			return data;
+		}
+
+		UCHAR info[34];
+		Soundtrack::Bits bits(info);
+
+		bits.put(SOUND_BLOCK, 16);
+		bits.put(SOUND_BLOCK, 16);
+		bits.put(Soundtrack::smallest, 24);
+		bits.put(Soundtrack::largest, 24);
+		bits.put(SAMPLE_RATE, 20);
+		bits.put(AUDIO_CHANNELS - 1, 3);
+		bits.put(15, 5);
+		bits.put(Soundtrack::frames >> 32, 4);
+		bits.put(Soundtrack::frames, 32);
+
+		for (int i = 0; i < 4; ++i) {
+			bits.put(0, 32);
+		}
+
+		tag("fLaC");
+		block(false, 0, sizeof(info));
+		data.insert(data.end(), info, info + sizeof(info));
+
+		std::size_t end = data.size() + SOUND_RESERVE;
+
+		if (final) {
+			std::vector<std::string> comments;
+			std::size_t size = 4 + strlen(NAME) + 4;
+
+			for (Soundtrack::Gap &gap : Soundtrack::markers) {
+				std::string comment = "GAP=" + std::to_string(gap.start) + ":" + std::to_string(gap.length);
+
+				if (size + 4 + comment.size() + 8 > SOUND_RESERVE) {
+					printf("[%s] Only %zu of %zu gaps fit in \"%s\".\n", NAME, comments.size(), Soundtrack::markers.size(), Soundtrack::path.c_str());
+					break;
+				}
+
+				size += 4 + comment.size();
+				comments.push_back(comment);
+			}
+
+			block(false, 4, size);
+			put(strlen(NAME), 4);
+			tag(NAME);
+			put(comments.size(), 4);
+
+			for (std::string &comment : comments) {
+				put(comment.size(), 4);
+				tag(comment.c_str());
+			}
+		}
+
+		block(true, 1, end - data.size() - 4);
+		data.resize(end, 0x00);
+
+		return data;
+	}
+
+	static inline std::vector<UCHAR> trailer() {
+		std::vector<UCHAR> data;
+		uint32_t count = Soundtrack::markers.size();
+
+		auto put = [&](uint32_t value, int bytes) {
+			for (int i = 0; i < bytes; ++i) {
+				data.push_back(value >> i * 8);
+			}
+		};
+
+		auto tag = [&](const char *p_tag) {
+			data.insert(data.end(), p_tag, p_tag + 4);
+		};
+
+		tag("cue ");
+		put(4 + count * 24, 4);
+		put(count, 4);
+
+		for (uint32_t i = 0; i < count; ++i) {
+			put(i + 1, 4);
+			put(Soundtrack::markers[i].start, 4);
+			tag("data");
+			put(0, 4);
+			put(0, 4);
+			put(Soundtrack::markers[i].start, 4);
+		}
+
+		tag("LIST");
+		put(4 + count * 48, 4);
+		tag("adtl");
+
+		for (uint32_t i = 0; i < count; ++i) {
+			tag("labl");
+			put(8, 4);
+			put(i + 1, 4);
+			tag("gap");
+
+			tag("ltxt");
+			put(24, 4);
+			put(i + 1, 4);
+			put(Soundtrack::markers[i].length, 4);
+			tag("rgn ");
+			put(0, 4);
+			put(0, 4);
+			tag("gap");
+		}
+
+		return data;
+	}
+
+	static inline std::size_t encode(const sf::Int16 *p_in, int count, uint32_t number, UCHAR *p_out) {
+		for (int i = 0; i < count; ++i) {
+			int32_t left = p_in[i * 2];
+			int32_t right = p_in[i * 2 + 1];
+
+			Soundtrack::channels[0][i] = left;
+			Soundtrack::channels[1][i] = right;
+			Soundtrack::channels[2][i] = (left + right) >> 1;
+			Soundtrack::channels[3][i] = left - right;
+		}
+
+		Soundtrack::Choice choices[4];
+
+		for (int i = 0; i < 4; ++i) {
+			choices[i] = Soundtrack::analyze(Soundtrack::channels[i], count, i == 3 ? 17 : 16);
+		}
+
+		static constexpr int pairs[4][2] = { { 0, 1 }, { 0, 3 }, { 3, 1 }, { 2, 3 } };
+		static constexpr int codes[4] = { 0x01, 0x08, 0x09, 0x0A };
+
+		int best = 0;
+
+		for (int i = 1; i < 4; ++i) {
+			if (choices[pairs[i][0]].bits + choices[pairs[i][1]].bits < choices[pairs[best][0]].bits + choices[pairs[best][1]].bits) {
+				best = i;
+			}
+		}
+
+		Soundtrack::Bits bits(p_out);
+
+		bits.put(0xFFF8, 16);
+		bits.put(0x7D, 8);
+		bits.put(codes[best] << 4 | 0x08, 8);
+
+		if (number < 0x80) {
+			bits.put(number, 8);
+		}
+
+		else {
+			int bytes = 2;
+
+			while (bytes < 6 && number >= 1u << (5 * bytes + 1)) {
+				++bytes;
+			}
+
+			bits.put((0xFF00 >> bytes & 0xFF) | number >> 6 * (bytes - 1), 8);
+
+			for (int i = bytes - 2; i >= 0; --i) {
+				bits.put(0x80 | (number >> 6 * i & 0x3F), 8);
+			}
+		}
+
+		bits.put(count - 1, 16);
+		bits.put(SAMPLE_RATE, 16);
+		bits.put(Soundtrack::crc8(p_out, bits.size()), 8);
+
+		for (int channel : pairs[best]) {
+			Soundtrack::subframe(&bits, Soundtrack::channels[channel], count, channel == 3 ? 17 : 16, choices[channel]);
+		}
+
+		bits.align();
+		bits.put(Soundtrack::crc16(p_out, bits.size()), 16);
+
+		return bits.size();
+	}
+
+	static inline Soundtrack::Choice analyze(const int32_t *p_in, int count, int depth) {
+		bool constant = true;
+
+		for (int i = 1; i < count && constant; ++i) {
+			constant = p_in[i] == p_in[0];
+		}
+
+		if (constant) {
+			return { Soundtrack::Subframe::CONSTANT, 0, static_cast<uint64_t>(8 + depth) };
+		}
+
+		Soundtrack::Choice best = { Soundtrack::Subframe::VERBATIM, 0, 8 + static_cast<uint64_t>(count) * depth };
+
+		for (int order = 0; order <= SOUND_ORDER && order < count; ++order) {
+			Soundtrack::predict(p_in, count, order);
+
+			int partition;
+			uint64_t bits = 8 + order * depth + Soundtrack::rice(count, order, &partition);
+
+			if (bits < best.bits) {
+				best = { Soundtrack::Subframe::FIXED, order, bits };
+			}
+		}
+
+		return best;
+	}
+
+	static inline void subframe(Soundtrack::Bits *p_bits, const int32_t *p_in, int count, int depth, Soundtrack::Choice choice) {
+		uint32_t mask = (1u << depth) - 1;
+
+		if (choice.type == Soundtrack::Subframe::CONSTANT) {
+			p_bits->put(0x00, 8);
+			p_bits->put(p_in[0] & mask, depth);
+
+			return;
+		}
+
+		if (choice.type == Soundtrack::Subframe::VERBATIM) {
+			p_bits->put(0x02, 8);
+
+			for (int i = 0; i < count; ++i) {
+				p_bits->put(p_in[i] & mask, depth);
+			}
+
+			return;
+		}
+
+		p_bits->put((0x08 | choice.order) << 1, 8);
+
+		for (int i = 0; i < choice.order; ++i) {
+			p_bits->put(p_in[i] & mask, depth);
+		}
+
+		Soundtrack::predict(p_in, count, choice.order);
+
+		int partition;
+		Soundtrack::rice(count, choice.order, &partition);
+
+		p_bits->put(0, 2);
+		p_bits->put(partition, 4);
+
+		int size = count >> partition;
+
+		for (int i = 0; i < 1 << partition; ++i) {
+			p_bits->put(Soundtrack::params[i], 4);
+
+			for (int j = i ? i * size : choice.order; j < (i + 1) * size; ++j) {
+				p_bits->rice(Soundtrack::folded[j], Soundtrack::params[i]);
+			}
+		}
+	}
+
+	static inline void predict(const int32_t *p_in, int count, int order) {
+		for (int i = order; i < count; ++i) {
+			switch (order) {
+				case 0:
+					Soundtrack::residual[i] = p_in[i];
+					break;
+
+				case 1:
+					Soundtrack::residual[i] = p_in[i] - p_in[i - 1];
+					break;
+
+				case 2:
+					Soundtrack::residual[i] = p_in[i] - 2 * p_in[i - 1] + p_in[i - 2];
+					break;
+
+				case 3:
+					Soundtrack::residual[i] = p_in[i] - 3 * p_in[i - 1] + 3 * p_in[i - 2] - p_in[i - 3];
+					break;
+
+				default:
+					Soundtrack::residual[i] = p_in[i] - 4 * p_in[i - 1] + 6 * p_in[i - 2] - 4 * p_in[i - 3] + p_in[i - 4];
+			}
+
+			Soundtrack::folded[i] = static_cast<uint32_t>(Soundtrack::residual[i]) << 1 ^ static_cast<uint32_t>(Soundtrack::residual[i] >> 31);
+		}
+	}
+
+	static inline uint64_t rice(int count, int order, int *p_partition) {
+		uint64_t best = UINT64_MAX;
+		int chosen[1 << SOUND_PARTITION];
+
+		for (int partition = 0; partition <= SOUND_PARTITION; ++partition) {
+			int size = count >> partition;
+
+			if (count % (1 << partition) || size <= order) {
+				break;
+			}
+
+			uint64_t bits = 6;
+
+			for (int i = 0; i < 1 << partition; ++i) {
+				int start = i ? i * size : order;
+				uint64_t sum = 0;
+
+				for (int j = start; j < (i + 1) * size; ++j) {
+					sum += Soundtrack::folded[j];
+				}
+
+				uint64_t cost = UINT64_MAX;
+
+				for (int k = 0; k <= SOUND_RICE; ++k) {
+					uint64_t estimate = static_cast<uint64_t>((i + 1) * size - start) * (k + 1) + (sum >> k);
+
+					if (estimate < cost) {
+						cost = estimate;
+						chosen[i] = k;
+					}
+				}
+
+				bits += 4 + cost;
+			}
+
+			if (bits < best) {
+				best = bits;
+				*p_partition = partition;
+
+				memcpy(Soundtrack::params, chosen, sizeof(int) << partition);
+			}
+		}
+
+		return best;
+	}
+
+	static inline uint8_t crc8(const UCHAR *p_data, std::size_t size) {
+		uint8_t crc = 0;
+
+		for (std::size_t i = 0; i < size; ++i) {
+			crc ^= p_data[i];
+
+			for (int j = 0; j < 8; ++j) {
+				crc = crc & 0x80 ? crc << 1 ^ 0x07 : crc << 1;
+			}
+		}
+
+		return crc;
+	}
+
+	static inline uint16_t crc16(const UCHAR *p_data, std::size_t size) {
+		uint16_t crc = 0;
+
+		for (std::size_t i = 0; i < size; ++i) {
+			crc ^= p_data[i] << 8;
+
+			for (int j = 0; j < 8; ++j) {
+				crc = crc & 0x8000 ? crc << 1 ^ 0x8005 : crc << 1;
+			}
+		}
+
+		return crc;
+	}
+};
+
+class Publisher {
+public:
+	static_assert(SHARED_VIDEO == FRAME_SIZE_RGB && SHARED_AUDIO == SAMPLE_SIZE_8 && SHARED_WIDTH == CAP_WIDTH && SHARED_HEIGHT == CAP_HEIGHT, "Shared frame layout mismatch.");
+
+	static inline bool enabled = false;
+
+	Publisher(std::string name) : m_name("/" + name) {
+		int fd = shm_open(this->m_name.c_str(), O_CREAT | O_RDWR, 0644);
+
+		if (fd < 0 || ftruncate(fd, SHARED_SIZE)) {
+			printf("[%s] Shared memory \"%s\" open failed.\n", NAME, this->m_name.c_str());
+
+			if (fd >= 0) {
+				::close(fd);
+			}
+
+			return;
+		}
+
+		void *p_base = mmap(nullptr, SHARED_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+
+		if (p_base == MAP_FAILED) {
+			printf("[%s] Shared memory \"%s\" map failed.\n", NAME, this->m_name.c_str());
+			return;
+		}
+
+		Shared::Header *p_header = static_cast<Shared::Header*>(p_base);
+
+		p_header->magic = 0;
+		p_header->version = SHARED_VERSION;
+
+		p_header->count = SHARED_COUNT;
+		p_header->stride = SHARED_STRIDE;
+
+		p_header->width = CAP_WIDTH;
+		p_header->height = CAP_HEIGHT;
+
+		p_header->sample_rate = SAMPLE_RATE;
+		p_header->channels = AUDIO_CHANNELS;
+
+		p_header->head.store(0, std::memory_order_relaxed);
+
+		for (int i = 0; i < SHARED_COUNT; ++i) {
+			Shared::slot(p_base, i)->lock.store(0, std::memory_order_relaxed);
+			Shared::slot(p_base, i)->index = UINT64_MAX;
+		}
+
+		std::atomic_thread_fence(std::memory_order_release);
+		p_header->magic = SHARED_MAGIC;
+
+		this->m_base = p_base;
+	}
+
+	~Publisher() {
+		if (this->m_base) {
+			munmap(this->m_base, SHARED_SIZE);
+			shm_unlink(this->m_name.c_str());
+		}
+	}
+
+	void push(UCHAR *p_buf, ULONG read, uint64_t sequence, int64_t time) {
+		if (!this->m_base || read < FRAME_SIZE_RGB) {
+			return;
+		}
+
+		Shared::Header *p_header = static_cast<Shared::Header*>(this->m_base);
+		Shared::Slot *p_slot = Shared::slot(this->m_base, this->m_head);
+
+		uint64_t lock = p_slot->lock.load(std::memory_order_relaxed);
+
+		p_slot->lock.store(lock + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		UCHAR *p_out = reinterpret_cast<UCHAR*>(p_slot) + sizeof(Shared::Slot);
+
+		for (int i = 0, j = DELTA_RES / CAP_WIDTH, k = TOP_RES / CAP_WIDTH; i < CAP_HEIGHT; ++i) {
+			int line = i < DELTA_RES / CAP_WIDTH ? i : i & 1 ? j++ : k++;
+			memcpy(&p_out[line * CAP_WIDTH * 3], &p_buf[i * CAP_WIDTH * 3], CAP_WIDTH * 3);
+		}
+
+		uint32_t audio = std::min<ULONG>(read, BUF_SIZE) - FRAME_SIZE_RGB;
+		memcpy(&p_out[FRAME_SIZE_RGB], &p_buf[FRAME_SIZE_RGB], audio);
+
+		p_slot->index = this->m_head;
+		p_slot->sequence = sequence;
+		p_slot->time = time;
+
+		p_slot->video = FRAME_SIZE_RGB;
+		p_slot->audio = audio;
+
+		p_slot->lock.store(lock + 2, std::memory_order_release);
+		p_header->head.store(++this->m_head, std::memory_order_release);
+	}
+
+private:
+	std::string m_name;
+
+	void *m_base = nullptr;
+	uint64_t m_head = 0;
+};
+
+class Capture {
+public:
+	struct Frame {
+		int index;
+		bool starting;
+		bool leased;
+
+		uint64_t sequence;
+		sf::Int64 time;
+	};
+
+	class Source {
+	public:
+		virtual ~Source() {}
+
+		std::atomic<uint64_t> m_aborts = 0;
+		bool m_paced = true;
+
+		virtual bool open(int count) = 0;
+		virtual void close() = 0;
+
+		virtual bool submit(UCHAR *p_buf, ULONG *p_read, int index) = 0;
+		virtual bool complete(int index) = 0;
+
+		virtual void seek(double seconds, bool absolute) {}
+		virtual void pause() {}
+		virtual void step() {}
+	};
+
+	class Device : public Source {
+	public:
+		std::string m_serial;
+		int m_number = 0;
+
+		Device() {}
+		Device(std::string serial) : m_serial(serial) {}
+		Device(int number) : m_number(number) {}
+
+		static std::vector<std::string> list() {
+			std::vector<std::string> serials;
+			DWORD count = 0;
+
+			if (FT_CreateDeviceInfoList(&count) || !count) {
+				return serials;
+			}
+
+			std::vector<FT_DEVICE_LIST_INFO_NODE> nodes(count);
+
+			if (FT_GetDeviceInfoList(nodes.data(), &count)) {
+				return serials;
+			}
+
+			for (DWORD i = 0; i < count; ++i) {
+				if (strcmp(nodes[i].Description, PRODUCT_1) == 0 || strcmp(nodes[i].Description, PRODUCT_2) == 0) {
+					serials.push_back(nodes[i].SerialNumber);
+				}
+			}
+
+			return serials;
+		}
+
+		bool open(int count) override {
+			this->m_count = 0;
+
+			if (!this->create()) {
+				printf("[%s] Create failed.\n", NAME);
+				return false;
+			}
+
+			UCHAR buf[4] = {0x40, 0x80, 0x00, 0x00};
+			ULONG written = 0;
+
+			if (FT_WritePipe(this->m_handle, BULK_OUT, buf, 4, &written, 0)) {
+				printf("[%s] Write failed.\n", NAME);
+				this->close();
+
+				return false;
+			}
+
+			buf[1] = 0x00;
+
+			if (FT_WritePipe(this->m_handle, BULK_OUT, buf, 4, &written, 0)) {
+				printf("[%s] Write failed.\n", NAME);
+				this->close();
+
+				return false;
+			}
+
+			if (FT_SetStreamPipe(this->m_handle, false, false, BULK_IN, BUF_SIZE)) {
+				printf("[%s] Stream failed.\n", NAME);
+				this->close();
+
+				return false;
+			}
+
+			for (; this->m_count < count; ++this->m_count) {
+				if (FT_InitializeOverlapped(this->m_handle, &this->m_overlap[this->m_count])) {
+					printf("[%s] Initialize failed.\n", NAME);
+					this->close();
+
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void close() override {
+			for (int i = 0; i < this->m_count; ++i) {
+				if (FT_ReleaseOverlapped(this->m_handle, &this->m_overlap[i])) {
+					printf("[%s] Release failed.\n", NAME);
+				}
+			}
+
+			if (FT_Close(this->m_handle)) {
+				printf("[%s] Close failed.\n", NAME);
+			}
+		}
+
+		bool submit(UCHAR *p_buf, ULONG *p_read, int index) override {
+			this->m_read[index] = p_read;
+			return FT_ReadPipeAsync(this->m_handle, FIFO_CHANNEL, p_buf, BUF_SIZE, p_read, &this->m_overlap[index]) == FT_IO_PENDING;
+		}
+
+		bool complete(int index) override {
+			if (FT_GetOverlappedResult(this->m_handle, &this->m_overlap[index], this->m_read[index], true) != FT_IO_INCOMPLETE) {
+				return true;
+			}
+
+			++this->m_aborts;
+
+			if (FT_AbortPipe(this->m_handle, BULK_IN)) {
+				printf("[%s] Abort failed.\n", NAME);
+				return false;
+			}
+
+			return true;
+		}
+
+	private:
+		FT_HANDLE m_handle;
+		OVERLAPPED m_overlap[BUF_LIMIT];
+
+		ULONG *m_read[BUF_LIMIT];
+		int m_count = 0;
+
+		bool create() {
+			if (this->m_serial.empty() && !this->m_number) {
+				return !FT_Create(const_cast<char*>(PRODUCT_1), FT_OPEN_BY_DESCRIPTION, &this->m_handle) || !FT_Create(const_cast<char*>(PRODUCT_2), FT_OPEN_BY_DESCRIPTION, &this->m_handle);
+			}
+
+			std::string serial = this->m_serial;
+
+			if (serial.empty()) {
+				std::vector<std::string> serials = Device::list();
+
+				if (this->m_number >= static_cast<int>(serials.size())) {
+					return false;
+				}
+
+				serial = serials[this->m_number];
+			}
+
+			return !FT_Create(const_cast<char*>(serial.c_str()), FT_OPEN_BY_SERIAL_NUMBER, &this->m_handle);
+		}
+	};
+
+	class Synthetic : public Source {
+	public:
+		int m_short = 0;
+		int m_stall = 0;
+
+		bool open(int count) override {
+			this->m_clock.restart();
+
+			this->m_deadline = 0.0;
+			this->m_frame = 0;
+
+			return true;
+		}
+
+		void close() override {}
+
+		bool submit(UCHAR *p_buf, ULONG *p_read, int index) override {
+			this->m_buf[index] = p_buf;
+			this->m_read[index] = p_read;
+
+			return true;
+		}
+
+		bool complete(int index) override {
+			++this->m_frame;
+
+			if (this->m_stall && this->m_frame % this->m_stall == 0) {
+				sf::sleep(sf::milliseconds(STALL_TIME));
+				this->m_deadline = this->m_clock.getElapsedTime().asMicroseconds();
+			}
+
+			if (this->m_paced) {
+				this->m_deadline += 1000000 / FRAME_RATE;
+				sf::sleep(sf::microseconds(this->m_deadline - this->m_clock.getElapsedTime().asMicroseconds()));
+			}
+
+			this->video(this->m_buf[index]);
+			*this->m_read[index] = FRAME_SIZE_RGB + this->audio(&this->m_buf[index][FRAME_SIZE_RGB]);
+
+			if (this->m_short && this->m_frame % this->m_short == 0) {
+				*this->m_read[index] = FRAME_SIZE_RGB / 2;
+			}
+
+			return true;
+		}
+
+	private:
+		UCHAR *m_buf[BUF_LIMIT];
+		ULONG *m_read[BUF_LIMIT];
+
+		sf::Clock m_clock;
+		double m_deadline = 0.0;
+
+		int m_frame = 0;
+
+		double m_phase = 0.0;
+		double m_samples = 0.0;
+
+		void video(UCHAR *p_out) {
+			for (int i = 0; i < CAP_HEIGHT; ++i) {
+				bool top = i < DELTA_RES / CAP_WIDTH || i & 1;
+				int x = top ? (i < DELTA_RES / CAP_WIDTH ? i : DELTA_RES / CAP_WIDTH + (i - DELTA_RES / CAP_WIDTH) / 2) : (i - DELTA_RES / CAP_WIDTH) / 2;
+
+				for (int y = 0; y < CAP_WIDTH; ++y) {
+					UCHAR *p_pixel = &p_out[(i * CAP_WIDTH + y) * 3];
+
+					if (top) {
+						int bar = (x + this->m_frame) / 50 % 8;
+
+						p_pixel[0] = bar & 1 ? 0xff : 0x00;
+						p_pixel[1] = bar & 2 ? 0xff : 0x00;
+						p_pixel[2] = bar & 4 ? 0xff : 0x00;
+					}
+
+					else {
+						p_pixel[0] = x * 255 / 320;
+						p_pixel[1] = y * 255 / 240;
+						p_pixel[2] = this->m_frame & 0xff;
+					}
+				}
+			}
+		}
+
+		int audio(UCHAR *p_out) {
+			this->m_samples += static_cast<double>(SAMPLE_RATE) / FRAME_RATE;
+
+			int count = std::min(static_cast<int>(this->m_samples), SAMPLE_SIZE_16 / AUDIO_CHANNELS);
+			this->m_samples -= count;
+
+			for (int i = 0; i < count; ++i) {
+				sf::Int16 sample = 8192 * std::sin(this->m_phase);
+				this->m_phase = std::fmod(this->m_phase + 2 * M_PI * 440 / SAMPLE_RATE, 2 * M_PI);
+
+				for (int j = 0; j < AUDIO_CHANNELS; ++j) {
+					p_out[(i * AUDIO_CHANNELS + j) * 2 + 0] = sample & 0xff;
+					p_out[(i * AUDIO_CHANNELS + j) * 2 + 1] = sample >> 8 & 0xff;
+				}
+			}
+
+			return count * AUDIO_CHANNELS * 2;
+		}
+	};
+
+	class Replay : public Source {
+	public:
+		struct Entry {
+			uint64_t offset;
+			int64_t time;
+
+			uint32_t size;
+			uint32_t flags;
+		};
+
+		struct Index {
+			char magic[8];
+
+			uint32_t version;
+			uint32_t count;
+
+			uint64_t size;
+			int64_t modified;
+		};
+
+		std::string m_path;
+
+		static inline double speed = 1.0;
+		static inline double offset = 0.0;
+		static inline bool stepping = false;
+
+		Replay(std::string path) : m_path(path) {}
+
+		~Replay() {
+			this->close();
+		}
+
+		bool open(int count) override {
+			this->close();
+
+			int fd = ::open(this->m_path.c_str(), O_RDONLY);
+			struct stat info;
+
+			void *p_map = fd >= 0 && !fstat(fd, &info) && info.st_size > 0 ? mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+			if (fd >= 0) {
+				::close(fd);
+			}
+
+			if (p_map == MAP_FAILED) {
+				printf("[%s] File \"%s\" open failed.\n", NAME, this->m_path.c_str());
+				return false;
+			}
+
+			this->m_map = static_cast<UCHAR*>(p_map);
+			this->m_size = info.st_size;
+
+			Recorder::Header header = {};
+			memcpy(&header, this->m_map, std::min<std::size_t>(sizeof(header), this->m_size));
+
+			this->m_recorded = this->m_size >= RECORD_ALIGN && Recorder::valid(&header);
+			this->m_codec = this->m_recorded ? header.codec : RECORD_RAW;
+
+			if (this->m_modified != info.st_mtime || this->m_entries.empty()) {
+				this->m_modified = info.st_mtime;
+
+				if (!this->m_recorded || !this->load()) {
+					this->index();
+				}
+			}
+
+			if (this->m_entries.empty()) {
+				printf("[%s] File \"%s\" has no packets.\n", NAME, this->m_path.c_str());
+				this->close();
+
+				return false;
+			}
+
+			if (!this->m_opened) {
+				this->m_opened = true;
+
+				this->m_target = Replay::offset > 0.0 || Replay::stepping ? static_cast<int64_t>(Replay::offset * 1000000) : REPLAY_NONE;
+				this->m_paused = Replay::stepping;
+			}
+
+			this->m_position = 0;
+			this->m_played = 0;
+
+			this->m_clock.restart();
+			this->m_deadline = 0.0;
+
+			return true;
+		}
+
+		void close() override {
+			if (!this->m_map) {
+				return;
+			}
+
+			double seconds = this->m_clock.getElapsedTime().asSeconds();
+			printf("[%s] Replayed %llu packets in %.2f s, %.2f FPS.\n", NAME, static_cast<unsigned long long>(this->m_played), seconds, seconds > 0.0 ? this->m_played / seconds : 0.0);
+
+			munmap(this->m_map, this->m_size);
+			this->m_map = nullptr;
+		}
+
+		bool submit(UCHAR *p_buf, ULONG *p_read, int index) override {
+			this->m_buf[index] = p_buf;
+			this->m_read[index] = p_read;
+
+			return true;
+		}
+
+		bool complete(int index) override {
+			while (this->m_paused && !this->m_steps && this->m_target == REPLAY_NONE) {
+				if (!g_running) {
+					return false;
+				}
+
+				sf::sleep(sf::milliseconds(REPLAY_POLL));
+			}
+
+			if (this->m_paused && this->m_steps) {
+				--this->m_steps;
+				this->m_deadline = this->m_clock.getElapsedTime().asMicroseconds();
+			}
+
+			int64_t target = this->m_target.exchange(REPLAY_NONE);
+
+			if (target != REPLAY_NONE) {
+				this->locate(target);
+				this->m_deadline = this->m_clock.getElapsedTime().asMicroseconds();
+			}
+
+			if (this->m_paced && Replay::speed > 0.0) {
+				this->m_deadline += 1000000 / FRAME_RATE / Replay::speed;
+				sf::sleep(sf::microseconds(this->m_deadline - this->m_clock.getElapsedTime().asMicroseconds()));
+			}
+
+			if (this->m_position == this->m_entries.size()) {
+				this->m_position = 0;
+			}
+
+			if (!this->next(index)) {
+				printf("[%s] File \"%s\" read failed.\n", NAME, this->m_path.c_str());
+				return false;
+			}
+
+			return true;
+		}
+
+		void seek(double seconds, bool absolute) override {
+			this->m_target = std::max<int64_t>((absolute ? 0 : this->m_time.load()) + seconds * 1000000, 0);
+		}
+
+		void pause() override {
+			this->m_paused = !this->m_paused;
+			printf("[%s] Replay %s at %.2f s.\n", NAME, this->m_paused ? "paused" : "resumed", this->m_time / 1000000.0);
+		}
+
+		void step() override {
+			if (this->m_paused) {
+				++this->m_steps;
+			}
+		}
+
+	private:
+		UCHAR *m_map = nullptr;
+		std::size_t m_size = 0;
+		int64_t m_modified = 0;
+
+		bool m_recorded = false;
+		uint32_t m_codec = RECORD_RAW;
+
+		std::vector<Replay::Entry> m_entries;
+		std::size_t m_position = 0;
+		uint64_t m_played = 0;
+
+		std::vector<UCHAR> m_frame = std::vector<UCHAR>(BUF_SIZE);
+
+		UCHAR *m_buf[BUF_LIMIT];
+		ULONG *m_read[BUF_LIMIT];
+
+		bool m_opened = false;
+
+		std::atomic<int64_t> m_target = REPLAY_NONE;
+		std::atomic<int64_t> m_time = 0;
+		std::atomic<bool> m_paused = false;
+		std::atomic<int> m_steps = 0;
+
+		sf::Clock m_clock;
+		double m_deadline = 0.0;
+
+		void index() {
+			sf::Clock clock;
+			this->m_entries.clear();
+
+			if (!this->m_recorded) {
+				for (uint64_t offset = 0; offset + BUF_SIZE <= this->m_size; offset += BUF_SIZE) {
+					this->m_entries.push_back({ offset, static_cast<int64_t>(this->m_entries.size() * 1000000 / FRAME_RATE), BUF_SIZE, RECORD_KEYFRAME });
+				}
+
+				return;
+			}
+
+			int64_t first = 0;
+
+			for (uint64_t offset = RECORD_ALIGN; offset + RECORD_HEADER <= this->m_size;) {
+				Recorder::Packet packet;
+				memcpy(&packet, &this->m_map[offset], sizeof(packet));
+
+				if (offset + RECORD_HEADER + packet.size > this->m_size || (this->m_codec == RECORD_RAW && packet.size < BUF_SIZE)) {
+					break;
+				}
+
+				if (this->m_entries.empty()) {
+					first = packet.time;
+				}
+
+				this->m_entries.push_back({ offset, packet.time - first, packet.size, this->m_codec == RECORD_RAW ? RECORD_KEYFRAME : packet.flags });
+				offset += RECORD_HEADER + packet.size;
+			}
+
+			printf("[%s] Indexed %zu packets of \"%s\" in %d ms.\n", NAME, this->m_entries.size(), this->m_path.c_str(), clock.getElapsedTime().asMilliseconds());
+
+			this->save();
+		}
+
+		bool load() {
+			std::ifstream file(this->m_path + ".idx", std::ios::binary);
+			Replay::Index index = {};
+
+			if (!file.read(reinterpret_cast<char*>(&index), sizeof(index)) || memcmp(index.magic, NAME, sizeof(index.magic)) || index.version != REPLAY_VERSION || index.size != this->m_size || index.modified != this->m_modified) {
+				return false;
+			}
+
+			this->m_entries.resize(index.count);
+
+			if (!file.read(reinterpret_cast<char*>(this->m_entries.data()), static_cast<std::streamsize>(index.count * sizeof(Replay::Entry)))) {
+				this->m_entries.clear();
+				return false;
+			}
+
+			return true;
+		}
+
+		void save() {
+			std::ofstream file(this->m_path + ".idx", std::ios::binary);
+
+			Replay::Index index = { {}, REPLAY_VERSION, static_cast<uint32_t>(this->m_entries.size()), this->m_size, this->m_modified };
+			memcpy(index.magic, NAME, sizeof(index.magic));
+
+			if (!file.write(reinterpret_cast<char*>(&index), sizeof(index)) || !file.write(reinterpret_cast<char*>(this->m_entries.data()), static_cast<std::streamsize>(this->m_entries.size() * sizeof(Replay::Entry)))) {
+				printf("[%s] File \"%s\" save failed.\n", NAME, (this->m_path + ".idx").c_str());
+			}
+		}
+
+		bool decode(Replay::Entry *p_entry) {
+			return Codec::decode(&this->m_map[p_entry->offset + RECORD_HEADER], p_entry->size, p_entry->flags & RECORD_KEYFRAME, this->m_frame.data());
+		}
+
+		void locate(int64_t time) {
+			sf::Clock clock;
+
+			std::size_t target = std::lower_bound(this->m_entries.begin(), this->m_entries.end(), time, [](const Replay::Entry &entry, int64_t time) { return entry.time < time; }) - this->m_entries.begin();
+			target = std::min(target, this->m_entries.size() - 1);
+
+			std::size_t position = target;
+
+			while (position && !(this->m_entries[position].flags & RECORD_KEYFRAME)) {
+				--position;
+			}
+
+			if (this->m_codec == RECORD_DELTA) {
+				for (; position < target; ++position) {
+					this->decode(&this->m_entries[position]);
+				}
+			}
+
+			this->m_position = target;
+			this->m_time = this->m_entries[target].time;
+
+			printf("[%s] Seek to %.2f s in %d us.\n", NAME, this->m_time / 1000000.0, static_cast<int>(clock.getElapsedTime().asMicroseconds()));
+		}
+
+		bool next(int index) {
+			Replay::Entry *p_entry = &this->m_entries[this->m_position];
+
+			if (!this->m_recorded) {
+				memcpy(this->m_buf[index], &this->m_map[p_entry->offset], BUF_SIZE);
+				*this->m_read[index] = BUF_SIZE;
+			}
+
+			else {
+				Recorder::Packet packet;
+				memcpy(&packet, &this->m_map[p_entry->offset], sizeof(packet));
+
+				if (this->m_codec == RECORD_DELTA) {
+					if (!this->decode(p_entry)) {
+						return false;
+					}
+
+					memcpy(this->m_buf[index], this->m_frame.data(), BUF_SIZE);
+				}
+
+				else {
+					memcpy(this->m_buf[index], &this->m_map[p_entry->offset + RECORD_HEADER], BUF_SIZE);
+				}
+
+				*this->m_read[index] = packet.read;
+			}
+
+			this->m_time = p_entry->time;
+
+			++this->m_position;
+			++this->m_played;
+
+			return true;
+		}
+	};
+
+	UCHAR *m_buf[BUF_POOL] = {};
+	ULONG m_read[BUF_POOL] = {};
+
+	std::atomic<int> m_size = 0;
+
+	int m_count = 0;
+	int m_depth = 0;
+
+	Source *m_source;
+	Publisher *m_publisher = nullptr;
+
+	int m_id;
+
+	std::string m_name;
+
+	bool m_starting = true;
+
+	std::atomic<bool> m_connected = false;
+	std::atomic<bool> m_connecting = true;
+	std::atomic<bool> m_disconnecting = false;
+
+	std::atomic<uint64_t> m_frames = 0;
+	std::atomic<uint64_t> m_connects = 0;
+	std::atomic<uint64_t> m_shorts = 0;
+	std::atomic<uint64_t> m_lates = 0;
+
+	std::atomic<uint64_t> m_waits = 0;
+	std::atomic<uint64_t> m_waited = 0;
+	std::atomic<uint64_t> m_stale = 0;
+
+	Queue<Capture::Frame, QUEUE_SIZE> m_audio;
+	Queue<Capture::Frame, QUEUE_SIZE> m_video;
+
+	static inline std::vector<Capture*> devices;
+	static inline std::atomic<int> selected = 0;
+
+	static inline bool auto_connect = false;
+	static inline bool audible = false;
+	static inline sf::Int64 started = 0;
+
+	static inline int count = BUF_COUNT;
+	static inline int depth = BUF_COUNT;
+	static inline bool tune = false;
+
+	Capture(Source *p_source) : m_source(p_source), m_id(Capture::devices.size()), m_name(this->m_id ? std::string(NAME) + "-" + std::to_string(this->m_id) : std::string(NAME)) {}
+
+	~Capture() {
+		delete this->m_publisher;
+		delete this->m_source;
+
+		for (UCHAR *p_slab : this->m_slabs) {
+			Realtime::free(p_slab, REALTIME_SLAB);
+		}
+	}
+
+	static inline void release() {
+		for (Capture *p_capture : Capture::devices) {
+			delete p_capture;
+		}
+
+		Capture::devices.clear();
+	}
+
+	void print() {
+		printf("[%s] Transfer queue depth %d of %d buffers, %llu aborts, %llu short reads, %llu late completions.\n", this->m_name.c_str(), this->m_depth, this->m_count, static_cast<unsigned long long>(this->m_source->m_aborts), static_cast<unsigned long long>(this->m_shorts), static_cast<unsigned long long>(this->m_lates));
+		printf("[%s] Buffer pool of %d, %llu waits for a free buffer totaling %llu ms, %llu stale reads.\n", this->m_name.c_str(), this->m_size.load(), static_cast<unsigned long long>(this->m_waits), static_cast<unsigned long long>(this->m_waited / 1000), static_cast<unsigned long long>(this->m_stale));
+	}
+
+	bool connect() {
+		if (this->m_connected) {
+			return true;
+		}
+
+		if (!this->m_source->open(this->m_count)) {
+			return false;
+		}
+
+		this->m_ready = TRANSFER_ABORT;
+
+		for (int i = 0; i < this->m_depth; ++i) {
+			if (!this->submit(i)) {
+				printf("[%s] Read failed.\n", NAME);
+				this->m_source->close();
+
+				std::fill(this->m_busy, this->m_busy + BUF_POOL, false);
+
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void allocate() {
+		this->m_count = std::clamp(Capture::tune && Capture::count == BUF_COUNT ? TUNE_COUNT : Capture::count, BUF_DEPTH, BUF_LIMIT);
+		this->m_depth = Capture::tune ? BUF_DEPTH : std::clamp(Capture::depth, 1, this->m_count);
+
+		while (this->m_size < this->m_count) {
+			this->grow();
+		}
+	}
+
+	bool acquire(const Capture::Frame &frame) {
+		if (frame.leased) {
+			return true;
+		}
+
+		this->m_leases[frame.index].fetch_add(1, std::memory_order_seq_cst);
+
+		if (this->m_generation[frame.index].load(std::memory_order_seq_cst) == frame.sequence) {
+			return true;
+		}
+
+		this->release(frame.index);
+		++this->m_stale;
+
+		return false;
+	}
+
+	void release(int index) {
+		this->m_leases[index].fetch_sub(1, std::memory_order_release);
+	}
+
+	void discard(const Capture::Frame &frame) {
+		if (frame.leased) {
+			this->release(frame.index);
+		}
+	}
+
+	static inline sf::Int64 now() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static inline uint64_t rung() {
+		std::lock_guard<std::mutex> lock(Capture::mutex);
+		return Capture::rings;
+	}
+
+	static inline void wait(uint64_t rings, int timeout) {
+		std::unique_lock<std::mutex> lock(Capture::mutex);
+		Capture::bell.wait_for(lock, std::chrono::milliseconds(timeout), [&] { return Capture::rings != rings; });
+	}
+
+	static inline void bench() {
+		Queue<Capture::Frame, QUEUE_SIZE> ping;
+		Queue<Capture::Frame, QUEUE_SIZE> pong;
+
+		std::thread echo([&] {
+			Capture::Frame frame;
+
+			for (int i = 0; i < BENCH_COUNT; ++i) {
+				ping.wait(&frame);
+				pong.push(frame);
+			}
+		});
+
+		Capture::Frame frame;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < BENCH_COUNT; ++i) {
+			ping.push({ i, false, false, static_cast<uint64_t>(i), Capture::now() });
+			pong.wait(&frame);
+		}
+
+		auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		echo.join();
+
+		Bench::record("queue.handoff", time / BENCH_COUNT / 2, "ns/handoff", frame.index == BENCH_COUNT - 1);
+	}
+
+	void stream() {
+		Realtime::apply(this->m_name, Realtime::Thread::CAPTURE, "Capture");
+
+		while (g_running) {
+			if (Recorder::device == this->m_id) {
+				Recorder::flush();
+			}
+
+			if (Soundtrack::device == this->m_id) {
+				Soundtrack::flush();
+			}
+
+			if (!this->m_connected) {
+				if ((Capture::auto_connect || this->m_connecting) && Capture::now() >= this->m_retry) {
+					this->m_connecting = false;
+
+					if ((this->m_connected = this->connect())) {
+						this->m_backoff = CONNECT_MIN;
+						++this->m_connects;
+					}
+
+					else {
+						this->m_retry = Capture::now() + this->m_backoff * 1000;
+						this->m_backoff = std::min(this->m_backoff * 2, CONNECT_MAX);
+					}
+				}
+
+				else {
+					sf::sleep(sf::milliseconds(5));
+				}
+
+				this->signal(&this->m_audio, TRANSFER_ABORT);
+
+				continue;
+			}
+
+			if (this->m_disconnecting || !this->transfer()) {
+				this->m_disconnecting = this->m_connected = this->disconnect();
+				this->signal(&this->m_video, TRANSFER_ABORT);
+
+				this->m_starting = true;
+				this->m_index = 0;
+				this->m_completed = 0;
+
+				continue;
+			}
+
+			this->signal(&this->m_audio, this->m_ready);
+			this->signal(&this->m_video, this->m_ready);
+
+			if (Recorder::device == this->m_id) {
+				Recorder::push(this->m_buf[this->m_ready], this->m_read[this->m_ready], this->m_sequence, Capture::now());
+			}
+
+			if (Soundtrack::device == this->m_id) {
+				Soundtrack::push(this->m_buf[this->m_ready], this->m_read[this->m_ready], this->m_sequence, Capture::now(), this->m_starting);
+			}
+
+			if (this->m_publisher) {
+				this->m_publisher->push(this->m_buf[this->m_ready], this->m_read[this->m_ready], this->m_sequence, Capture::now());
+			}
+
+			++this->m_sequence;
+			++this->m_frames;
+			this->m_index = (this->m_index + 1) % this->m_count;
+
+			if (this->m_starting) {
+				this->m_starting = this->m_index;
+			}
+		}
+
+		this->m_disconnecting = this->m_connected = this->disconnect();
+
+		while (!g_finished) {
+			this->signal(&this->m_audio, TRANSFER_ABORT);
+			this->signal(&this->m_video, TRANSFER_ABORT);
+
+			sf::sleep(sf::milliseconds(5));
+		}
+	}
+
+private:
+	int m_index = 0;
+	int m_ready = TRANSFER_ABORT;
+	uint64_t m_sequence = 0;
+
+	std::vector<UCHAR*> m_slabs;
+	int m_spare = 0;
+
+	int m_transfers[BUF_LIMIT] = {};
+	bool m_busy[BUF_POOL] = {};
+
+	std::atomic<uint32_t> m_leases[BUF_POOL] = {};
+	std::atomic<uint64_t> m_generation[BUF_POOL] = {};
+
+	sf::Int64 m_retry = 0;
+	int m_backoff = CONNECT_MIN;
+
+	sf::Int64 m_completed = 0;
+
+	uint64_t m_aborted = 0;
+
+	int m_window = 0;
+	int m_faults = 0;
+	int m_clean = 0;
+
+	static inline std::mutex mutex;
+	static inline std::condition_variable bell;
+	static inline uint64_t rings = 0;
+
+	bool disconnect() {
+		if (!this->m_connected) {
+			return false;
+		}
+
+		this->m_source->close();
+
+		std::fill(this->m_busy, this->m_busy + BUF_POOL, false);
+
+		return false;
+	}
+
+	bool grow() {
+		int size = this->m_size;
+
+		if (size == BUF_POOL) {
+			return false;
+		}
+
+		if (!this->m_spare) {
+			this->m_slabs.push_back(Realtime::allocate(REALTIME_SLAB));
+			this->m_spare = REALTIME_SLAB / BUF_SIZE;
+		}
+
+		this->m_buf[size] = this->m_slabs.back() + static_cast<std::size_t>(REALTIME_SLAB / BUF_SIZE - this->m_spare--) * BUF_SIZE;
+		this->m_generation[size] = UINT64_MAX;
+
+		this->m_size = size + 1;
+
+		if (size >= this->m_count) {
+			printf("[%s] Buffer pool grown to %d buffers.\n", this->m_name.c_str(), size + 1);
+		}
+
+		return true;
+	}
+
+	int claim() {
+		sf::Int64 start = 0;
+
+		while (g_running) {
+			int index = -1;
+
+			for (int i = 0; i < this->m_size; ++i) {
+				if (i != this->m_ready && !this->m_busy[i] && !this->m_leases[i].load(std::memory_order_acquire) && (index < 0 || this->m_generation[i] < this->m_generation[index])) {
+					index = i;
+				}
+			}
+
+			if (index >= 0) {
+				uint64_t generation = this->m_generation[index].exchange(UINT64_MAX, std::memory_order_seq_cst);
+
+				if (!this->m_leases[index].load(std::memory_order_seq_cst)) {
+					if (start) {
+						++this->m_waits;
+						this->m_waited += Capture::now() - start;
+					}
+
+					return index;
+				}
+
+				this->m_generation[index].store(generation, std::memory_order_release);
+				continue;
+			}
+
+			if (this->grow()) {
+				continue;
+			}
+
+			if (!start) {
+				start = Capture::now();
+			}
+
+			sf::sleep(sf::milliseconds(REALTIME_WAIT));
+		}
+
+		return TRANSFER_ABORT;
+	}
+
+	bool submit(int slot) {
+		int index = this->claim();
+
+		if (index == TRANSFER_ABORT) {
+			return false;
+		}
+
+		this->m_transfers[slot] = index;
+		this->m_busy[index] = true;
+
+		return this->m_source->submit(this->m_buf[index], &this->m_read[index], slot);
+	}
+
+	bool transfer() {
+		if (!this->m_source->complete(this->m_index)) {
+			return false;
+		}
+
+		this->m_ready = this->m_transfers[this->m_index];
+
+		this->m_busy[this->m_ready] = false;
+		this->m_generation[this->m_ready].store(this->m_sequence, std::memory_order_release);
+
+		int depth = this->adjust();
+
+		for (int i = this->m_depth; i <= depth; ++i) {
+			int index = (this->m_index + i) % this->m_count;
+
+			if (!this->submit(index)) {
+				if (g_running) {
+					printf("[%s] Read failed.\n", NAME);
+				}
+
+				return false;
+			}
+		}
+
+		this->m_depth = depth;
+
+		return true;
+	}
+
+	int adjust() {
+		sf::Int64 now = Capture::now();
+
+		if (this->m_read[this->m_ready] < FRAME_SIZE_RGB) {
+			++this->m_shorts;
+			++this->m_faults;
+		}
+
+		if (this->m_completed && now - this->m_completed > TUNE_LATE * 1000000 / FRAME_RATE) {
+			++this->m_lates;
+			++this->m_faults;
+		}
+
+		this->m_completed = now;
+
+		if (!Capture::tune || ++this->m_window < TUNE_WINDOW) {
+			return this->m_depth;
+		}
+
+		int depth = this->m_depth;
+		uint64_t aborts = this->m_source->m_aborts;
+
+		if (this->m_faults || aborts != this->m_aborted) {
+			depth = std::min(depth + 1, std::max(this->m_count - 2, this->m_depth));
+			this->m_clean = 0;
+		}
+
+		else if (++this->m_clean >= TUNE_CLEAN) {
+			depth = std::max(depth - 1, BUF_DEPTH);
+			this->m_clean = 0;
+		}
+
+		if (depth != this->m_depth) {
+			printf("[%s] Transfer queue depth %d of %d buffers.\n", this->m_name.c_str(), depth, this->m_count);
+		}
+
+		this->m_window = 0;
+		this->m_faults = 0;
+		this->m_aborted = aborts;
+
+		return depth;
+	}
+
+	void signal(Queue<Capture::Frame, QUEUE_SIZE> *p_queue, int index) {
+		bool leased = index != TRANSFER_ABORT && (p_queue == &this->m_video || (Capture::audible && Capture::selected == this->m_id));
+
+		if (leased) {
+			this->m_leases[index].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (!p_queue->push({ index, this->m_starting, leased, this->m_sequence, Capture::now() }) && leased) {
+			this->release(index);
+		}
+
+		if (p_queue == &this->m_video) {
+			{
+				std::lock_guard<std::mutex> lock(Capture::mutex);
+				++Capture::rings;
+			}
+
+			Capture::bell.notify_one();
+		}
+	}
+};
+
+class Histogram {
+public:
+	void record(sf::Int64 value) {
+		uint64_t count = std::max<sf::Int64>(value, 0);
+		this->m_counts[Histogram::bucket(count)].fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t max = this->m_max.load(std::memory_order_relaxed);
+
+		while (count > max && !this->m_max.compare_exchange_weak(max, count, std::memory_order_relaxed));
+	}
+
+	uint64_t total() {
+		uint64_t total = 0;
+
+		for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+			total += this->m_counts[i].load(std::memory_order_relaxed);
+		}
+
+		return total;
+	}
+
+	uint64_t percentile(double percent) {
+		uint64_t target = std::ceil(this->total() * percent / 100);
+		uint64_t total = 0;
+
+		for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+			total += this->m_counts[i].load(std::memory_order_relaxed);
+
+			if (total >= target && total) {
+				return std::min(Histogram::value(i), this->max());
+			}
+		}
+
+		return 0;
+	}
+
+	uint64_t max() {
+		return this->m_max.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> m_counts[HISTOGRAM_BUCKETS] = {};
+	std::atomic<uint64_t> m_max = 0;
+
+	static inline int bucket(uint64_t value) {
+		if (value < HISTOGRAM_LINEAR) {
+			return value;
+		}
+
+		int exponent = std::min(63 - __builtin_clzll(value), HISTOGRAM_EXPONENT);
+		int shift = exponent - HISTOGRAM_BITS + 1;
+
+		return HISTOGRAM_LINEAR + (exponent - HISTOGRAM_BITS) * HISTOGRAM_LINEAR / 2 + std::min<uint64_t>((value >> shift) - HISTOGRAM_LINEAR / 2, HISTOGRAM_LINEAR / 2 - 1);
+	}
+
+	static inline uint64_t value(int bucket) {
+		if (bucket < HISTOGRAM_LINEAR) {
+			return bucket;
+		}
+
+		int exponent = (bucket - HISTOGRAM_LINEAR) / (HISTOGRAM_LINEAR / 2) + HISTOGRAM_BITS;
+		int shift = exponent - HISTOGRAM_BITS + 1;
+
+		return (static_cast<uint64_t>((bucket - HISTOGRAM_LINEAR) % (HISTOGRAM_LINEAR / 2) + HISTOGRAM_LINEAR / 2) << shift) + (1ull << shift) / 2;
+	}
+};
+
+class Latency {
+public:
+	enum Stage { WAKE, MAP, SCALE, UPLOAD, DISPLAY, QUEUE, PLAY, COUNT };
+
+	static inline const char *names[Latency::Stage::COUNT] = { "wake", "map", "scale", "upload", "display", "queue", "play" };
+
+	static inline Histogram histograms[Latency::Stage::COUNT];
+
+	static inline void record(Latency::Stage stage, sf::Int64 time) {
+		Latency::histograms[stage].record(Capture::now() - time);
+	}
+
+	static inline std::string text() {
+		std::string text;
+
+		for (int i = 0; i < Latency::Stage::COUNT; ++i) {
+			char line[128];
+			snprintf(line, sizeof(line), "%-8s p50 %6.2f ms  p99 %6.2f ms  max %6.2f ms  (%llu)\n", Latency::names[i], Latency::histograms[i].percentile(50) / 1000.0, Latency::histograms[i].percentile(99) / 1000.0, Latency::histograms[i].max() / 1000.0, static_cast<unsigned long long>(Latency::histograms[i].total()));
+
+			text += line;
+		}
+
+		return text;
+	}
+
+	static inline void print() {
+		printf("[%s] Latency from USB completion:\n%s", NAME, Latency::text().c_str());
+	}
+};
+
+class Audio : public sf::SoundStream {
+public:
+	static inline Audio *p_audio;
+
+	static inline int volume = 50;
+	static inline bool mute = false;
+
+	static inline int latency = JITTER_TARGET;
+
+	static inline std::atomic<uint64_t> corrections = 0;
+	static inline std::atomic<uint64_t> inserted = 0;
+	static inline std::atomic<uint64_t> removed = 0;
+	static inline std::atomic<uint64_t> underruns = 0;
+	static inline std::atomic<uint64_t> overruns = 0;
+	static inline std::atomic<uint64_t> drops = 0;
+	static inline std::atomic<uint64_t> resets = 0;
+
+	Audio() {
+		this->initialize(AUDIO_CHANNELS, SAMPLE_RATE);
+		this->setVolume(0);
+
+		this->play();
+	}
+
+	static inline void adjust() {
+		Audio::p_audio->setVolume(Audio::starting || Audio::mute ? 0 : Audio::volume);
+	}
+
+	static inline void playback() {
+		Realtime::apply(NAME, Realtime::Thread::AUDIO, "Audio");
+
+		while (g_running) {
+			Capture *p_capture = Capture::devices[Capture::selected];
+			Capture::Frame frame;
+
+			if (p_capture->m_id != Audio::device) {
+				while (Capture::devices[Audio::device]->m_audio.pop(&frame)) {
+					Capture::devices[Audio::device]->discard(frame);
+				}
+
+				while (p_capture->m_audio.pop(&frame)) {
+					p_capture->discard(frame);
+				}
+
+				Audio::reset();
+				Audio::device = p_capture->m_id;
+			}
+
+			p_capture->m_audio.wait(&frame);
+
+			if (frame.index == TRANSFER_ABORT) {
+				continue;
+			}
+
+			if (frame.starting) {
+				p_capture->discard(frame);
+				Audio::reset();
+
+				continue;
+			}
+
+			if (!p_capture->acquire(frame)) {
+				++Audio::drops;
+				continue;
+			}
+
+			bool loaded = Audio::load(&p_capture->m_buf[frame.index][FRAME_SIZE_RGB], &p_capture->m_read[frame.index], frame.time);
+			p_capture->release(frame.index);
+
+			if (!loaded) {
+				++Audio::drops;
+				continue;
+			}
+
+			Audio::index = (Audio::index + 1) % BUF_COUNT;
+
+			if (Audio::starting) {
+				Audio::starting = Audio::index;
+				Audio::adjust();
+			}
+		}
+
+		delete Audio::p_audio;
+	}
+
+	static inline void pin() {
+		Realtime::pin(Audio::buf, sizeof(Audio::buf));
+		Realtime::pin(Audio::ring, sizeof(Audio::ring));
+		Realtime::pin(Audio::out, sizeof(Audio::out));
+	}
+
+	static inline void print() {
+		printf("[%s] Audio drift corrected in %llu packets, %llu samples inserted, %llu samples removed, %llu underruns, %llu overruns.\n", NAME, static_cast<unsigned long long>(Audio::corrections), static_cast<unsigned long long>(Audio::inserted), static_cast<unsigned long long>(Audio::removed), static_cast<unsigned long long>(Audio::underruns), static_cast<unsigned long long>(Audio::overruns));
+	}
+
+	static inline bool load(UCHAR *p_buf, ULONG *p_read, sf::Int64 time) {
+		if (*p_read <= FRAME_SIZE_RGB) {
+			return false;
+		}
+
+		int count = std::min<ULONG>(*p_read - FRAME_SIZE_RGB, SAMPLE_SIZE_8) / 2 / AUDIO_CHANNELS;
+
+		if (!count) {
+			return false;
+		}
+
+		sf::Int16 *p_samples = Audio::map(p_buf, Audio::buf, count);
+
+		uint32_t head = Audio::head.load(std::memory_order_relaxed);
+		uint32_t free = JITTER_SIZE - (head - Audio::tail.load(std::memory_order_acquire));
+
+		Audio::markers.push({ head, time });
+
+		int written = Audio::resample(p_samples, count, head, free);
+		Audio::head.store(head + written, std::memory_order_release);
+
+		Latency::record(Latency::Stage::QUEUE, time);
+
+		if (written > count) {
+			Audio::inserted += written - count;
+		}
+
+		else {
+			Audio::removed += count - written;
+		}
+
+		Audio::control(head + written - Audio::tail.load(std::memory_order_acquire));
+
+		return true;
+	}
+
+	static inline sf::Int16 *map(UCHAR *p_in, sf::Int16 *p_out, int count) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		return reinterpret_cast<sf::Int16*>(p_in);
+#else
+		int size = count * AUDIO_CHANNELS;
+		int i = 0;
+
+#if defined(__ARM_NEON)
+		for (; i + 8 <= size; i += 8) {
+			vst1q_u8(reinterpret_cast<uint8_t*>(&p_out[i]), vrev16q_u8(vld1q_u8(&p_in[i * 2])));
+		}
+#endif
+
+		for (; i < size; ++i) {
+			p_out[i] = p_in[i * 2 + 1] << 8 | p_in[i * 2];
+		}
+
+		return p_out;
+#endif
+	}
+
+	static inline void bench() {
+		std::vector<UCHAR> in(BUF_SIZE);
+		ULONG read = BUF_SIZE;
+
+		for (int i = 0; i < BUF_SIZE; ++i) {
+			in[i] = i * 2654435761u >> 24;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < BENCH_COUNT; ++i) {
+			Audio::map(&in[FRAME_SIZE_RGB], Audio::buf, SAMPLE_SIZE_16 / AUDIO_CHANNELS);
+		}
+
+		auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		Bench::record("audio.map", time / BENCH_COUNT, "ns/packet");
+
+		Audio::priming = false;
+
+		start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < BENCH_COUNT; ++i) {
+			Audio::load(&in[FRAME_SIZE_RGB], &read, Capture::now());
+			Audio::drain();
+		}
+
+		time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		Bench::record("audio.load", time / BENCH_COUNT, "ns/packet");
+
+		Audio::head = 0;
+		Audio::tail = 0;
+
+		while (Audio::markers.pop(&Audio::marker));
+
+		Audio::priming = true;
+
+		Audio::phase = 0.0;
+		Audio::step = 1.0;
+		Audio::fill = 0.0;
+		Audio::integral = 0.0;
+	}
+
+	static inline void drain() {
+		Audio::tail.store(Audio::head.load(std::memory_order_acquire) - Audio::target(), std::memory_order_release);
+	}
+
+private:
+	struct Marker {
+		uint32_t position;
+		sf::Int64 time;
+	};
+
+	static inline sf::Int16 buf[SAMPLE_SIZE_16];
+	static inline sf::Int16 ring[JITTER_SIZE * AUDIO_CHANNELS];
+	static inline sf::Int16 out[JITTER_CHUNK * AUDIO_CHANNELS];
+
+	static inline std::atomic<uint32_t> head = 0;
+	static inline std::atomic<uint32_t> tail = 0;
+	static inline uint32_t held = 0;
+
+	static inline Queue<Audio::Marker, JITTER_MARKERS> markers;
+	static inline Audio::Marker marker;
+	static inline bool marked = false;
+
+	static inline std::atomic<bool> priming = true;
+
+	static inline sf::Int16 last[AUDIO_CHANNELS];
+
+	static inline double phase = 0.0;
+	static inline double step = 1.0;
+	static inline double fill = 0.0;
+	static inline double integral = 0.0;
+
+	static inline bool starting = true;
+
+	static inline int device = 0;
+	static inline int index = 0;
+
+	static inline int target() {
+		return std::clamp(Audio::latency * SAMPLE_RATE / 1000, JITTER_CHUNK, JITTER_SIZE / 2);
+	}
+
+	static inline void reset() {
+		++Audio::resets;
+
+		Audio::phase = 0.0;
+		Audio::step = 1.0;
+		Audio::fill = Audio::head.load(std::memory_order_relaxed) - Audio::tail.load(std::memory_order_acquire);
+		Audio::integral = 0.0;
+	}
+
+	static inline int resample(sf::Int16 *p_in, int count, uint32_t head, uint32_t free) {
+		int written = 0;
+
+		for (; Audio::phase < count; Audio::phase += Audio::step) {
+			int i = Audio::phase;
+			double frac = Audio::phase - i;
+
+			if (static_cast<uint32_t>(written) == free) {
+				++Audio::overruns;
+				break;
+			}
+
+			sf::Int16 *p_out = &Audio::ring[(head + written) % JITTER_SIZE * AUDIO_CHANNELS];
+
+			for (int j = 0; j < AUDIO_CHANNELS; ++j) {
+				int a = i ? p_in[(i - 1) * AUDIO_CHANNELS + j] : Audio::last[j];
+				int b = p_in[i * AUDIO_CHANNELS + j];
+
+				p_out[j] = a + static_cast<int>(std::lround((b - a) * frac));
+			}
+
+			++written;
+		}
+
+		Audio::phase = std::max(Audio::phase - count, 0.0);
+		memcpy(Audio::last, &p_in[(count - 1) * AUDIO_CHANNELS], sizeof(Audio::last));
+
+		return written;
+	}
+
+	static inline void control(uint32_t level) {
+		if (Audio::priming) {
+			Audio::fill = level;
+			Audio::step = 1.0;
+
+			return;
+		}
+
+		Audio::fill += (level - Audio::fill) * JITTER_SMOOTHING;
+
+		double error = (Audio::fill - Audio::target()) / Audio::target();
+
+		Audio::integral = std::clamp(Audio::integral + error * JITTER_INTEGRAL, -JITTER_LIMIT, JITTER_LIMIT);
+		Audio::step = 1.0 + std::clamp(error * JITTER_GAIN + Audio::integral, -JITTER_LIMIT, JITTER_LIMIT);
+
+		if (std::abs(Audio::step - 1.0) > JITTER_EPSILON) {
+			++Audio::corrections;
+		}
+	}
+
+	bool onGetData(sf::SoundStream::Chunk &data) override {
+		if (!this->m_applied) {
+			Realtime::apply(NAME, Realtime::Thread::AUDIO, "Audio stream");
+			this->m_applied = true;
+		}
+
+		uint32_t tail = Audio::tail.load(std::memory_order_relaxed) + Audio::held;
+		Audio::tail.store(tail, std::memory_order_release);
+		Audio::held = 0;
+
+		uint32_t count = Audio::head.load(std::memory_order_acquire) - tail;
+
+		data.samples = Audio::out;
+		data.sampleCount = JITTER_CHUNK * AUDIO_CHANNELS;
+
+		if (Audio::priming) {
+			if (count < static_cast<uint32_t>(Audio::target())) {
+				memset(Audio::out, 0x00, sizeof(Audio::out));
+				return true;
+			}
+
+			Audio::priming = false;
+		}
+
+		count = std::min<uint32_t>(count, JITTER_CHUNK);
+
+		if (count == JITTER_CHUNK) {
+			count = std::min<uint32_t>(count, JITTER_SIZE - tail % JITTER_SIZE);
+
+			data.samples = &Audio::ring[tail % JITTER_SIZE * AUDIO_CHANNELS];
+			data.sampleCount = count * AUDIO_CHANNELS;
+
+			Audio::held = count;
+		}
+
+		else {
+			for (uint32_t i = 0; i < count; ++i) {
+				memcpy(&Audio::out[i * AUDIO_CHANNELS], &Audio::ring[(tail + i) % JITTER_SIZE * AUDIO_CHANNELS], AUDIO_CHANNELS * sizeof(sf::Int16));
+			}
+
+			for (uint32_t i = count; i < JITTER_CHUNK; ++i) {
+				for (int j = 0; j < AUDIO_CHANNELS; ++j) {
+					Audio::out[i * AUDIO_CHANNELS + j] = count ? Audio::out[(count - 1) * AUDIO_CHANNELS + j] * static_cast<int>(JITTER_CHUNK - i) / static_cast<int>(JITTER_CHUNK - count + 1) : 0;
+				}
+			}
+
+			++Audio::underruns;
+			Audio::priming = true;
+
+			Audio::tail.store(tail + count, std::memory_order_release);
+		}
+
+		while (Audio::marked || (Audio::marked = Audio::markers.pop(&Audio::marker))) {
+			if (static_cast<int32_t>(Audio::marker.position - (tail + count)) >= 0) {
+				break;
+			}
+
+			Latency::record(Latency::Stage::PLAY, Audio::marker.time);
+			Audio::marked = false;
+		}
+
+		return true;
+	}
+
+	void onSeek(sf::Time timeOffset) override {}
+
+	bool m_applied = false;
+};
+
+class Scaler {
+public:
+	enum Filter { NONE, SCALE2X, SCALE3X, HQ2X, XBR2X, XBR3X, COUNT };
+
+	static inline const int factors[Scaler::Filter::COUNT] = { 1, 2, 3, 2, 2, 3 };
+	static inline const char *names[Scaler::Filter::COUNT] = { "none", "scale2x", "scale3x", "hq2x", "xbr2x", "xbr3x" };
+
+	static inline Scaler *p_scaler = nullptr;
+
+	static inline void (*p_scale2x) (const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end);
+	static inline void (*p_scale3x) (const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end);
+
+	static inline void (*p_xbr2x) (const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], uint32_t *p_out);
+	static inline void (*p_xbr3x) (const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], uint32_t *p_out);
+
+	Scaler(int threads) {
+		this->m_threads = std::clamp(threads, 1, SCALER_BANDS);
+		this->m_yuv.resize(CAP_RES);
+
+		for (int i = 1; i < this->m_threads; ++i) {
+			this->m_workers.emplace_back(&Scaler::work, this, i);
+		}
+	}
+
+	~Scaler() {
+		{
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			this->m_stopping = true;
+		}
+
+		this->m_start.notify_all();
+
+		for (auto &worker : this->m_workers) {
+			worker.join();
+		}
+	}
+
+	static inline void detect() {
+		Scaler::p_scale2x = &Scaler::scale2x;
+		Scaler::p_scale3x = &Scaler::scale3x;
+
+		Scaler::p_xbr2x = &Scaler::xbr<2>;
+		Scaler::p_xbr3x = &Scaler::xbr<3>;
+
+		const char *p_name = "scalar";
+
+#if defined(__SSE2__)
+		Scaler::p_scale2x = &Scaler::scale2x_vector<Scaler::Sse2>;
+		Scaler::p_scale3x = &Scaler::scale3x_vector<Scaler::Sse2>;
+
+		Scaler::p_xbr2x = &Scaler::xbr_vector<Scaler::Sse2, 2>;
+		Scaler::p_xbr3x = &Scaler::xbr_vector<Scaler::Sse2, 3>;
+
+		p_name = "sse2";
+#elif defined(__ARM_NEON)
+		Scaler::p_scale2x = &Scaler::scale2x_vector<Scaler::Neon>;
+		Scaler::p_scale3x = &Scaler::scale3x_vector<Scaler::Neon>;
+
+		Scaler::p_xbr2x = &Scaler::xbr_vector<Scaler::Neon, 2>;
+		Scaler::p_xbr3x = &Scaler::xbr_vector<Scaler::Neon, 3>;
+
+		p_name = "neon";
+#endif
+
+		printf("[%s] Using %s scaler.\n", NAME, p_name);
+	}
+
+	static inline void bench() {
+		Scaler::detect();
+		Scaler scaler(std::thread::hardware_concurrency());
+
+		printf("[%s] Scaling on %d threads.\n", NAME, scaler.m_threads);
+
+		std::vector<uint32_t> in(CAP_RES);
+		std::vector<uint32_t> out(CAP_RES * 9);
+		std::vector<uint32_t> ref(CAP_RES * 9);
+
+		for (int i = 0; i < CAP_RES; ++i) {
+			in[i] = (i * 2654435761u >> 30) * 0x00555555 | 0xff000000;
+		}
+
+		UCHAR *p_in = reinterpret_cast<UCHAR*>(in.data());
+
+		void (*p_scale2x) (const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end) = Scaler::p_scale2x;
+		void (*p_scale3x) (const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end) = Scaler::p_scale3x;
+
+		void (*p_xbr2x) (const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], uint32_t *p_out) = Scaler::p_xbr2x;
+		void (*p_xbr3x) (const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], uint32_t *p_out) = Scaler::p_xbr3x;
+
+		for (int i = Scaler::Filter::SCALE2X; i < Scaler::Filter::COUNT; ++i) {
+			Scaler::Filter filter = static_cast<Scaler::Filter>(i);
+			std::size_t size = CAP_RES * Scaler::factors[filter] * Scaler::factors[filter];
+
+			Scaler::p_scale2x = &Scaler::scale2x;
+			Scaler::p_scale3x = &Scaler::scale3x;
+
+			Scaler::p_xbr2x = &Scaler::xbr<2>;
+			Scaler::p_xbr3x = &Scaler::xbr<3>;
+
+			scaler.scale(filter, p_in, ref.data(), 0, CAP_HEIGHT);
+
+			Scaler::p_scale2x = p_scale2x;
+			Scaler::p_scale3x = p_scale3x;
+
+			Scaler::p_xbr2x = p_xbr2x;
+			Scaler::p_xbr3x = p_xbr3x;
+
+			scaler.scale(filter, p_in, out.data(), 0, CAP_HEIGHT);
+
+			bool match = memcmp(ref.data(), out.data(), size * sizeof(uint32_t)) == 0;
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int j = 0; j < BENCH_COUNT; ++j) {
+				scaler.scale(filter, p_in, out.data(), 0, CAP_HEIGHT);
+			}
+
+			auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			Bench::record(std::string("scale.") + Scaler::names[filter], time / BENCH_COUNT, "ns/frame", match);
+		}
+	}
+
+	void scale(Scaler::Filter filter, UCHAR *p_in, uint32_t *p_out, int begin, int end) {
+		this->m_filter = filter;
+
+		this->m_in = p_in;
+		this->m_out = p_out;
+
+		this->m_begin = begin;
+		this->m_end = end;
+
+		if (filter >= Scaler::Filter::HQ2X) {
+			this->dispatch(Scaler::Stage::CONVERT);
+		}
+
+		this->dispatch(Scaler::Stage::FILTER);
+	}
+
+private:
+	enum Stage { CONVERT, FILTER };
+
+#if defined(__SSE2__)
+	class Sse2 {
+	public:
+		typedef __m128i Vector;
+
+		static inline Vector load(const uint32_t *p_in) {
+			return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p_in));
+		}
+
+		static inline Vector set(uint32_t value) {
+			return _mm_set1_epi32(value);
+		}
+
+		static inline Vector equal(Vector a, Vector b) {
+			return _mm_cmpeq_epi32(a, b);
+		}
+
+		static inline Vector less(Vector a, Vector b) {
+			return _mm_cmplt_epi32(a, b);
+		}
+
+		static inline Vector both(Vector a, Vector b) {
+			return _mm_and_si128(a, b);
+		}
+
+		static inline Vector either(Vector a, Vector b) {
+			return _mm_or_si128(a, b);
+		}
+
+		static inline Vector but(Vector a, Vector b) {
+			return _mm_andnot_si128(b, a);
+		}
+
+		static inline Vector select(Vector mask, Vector a, Vector b) {
+			return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+		}
+
+		static inline Vector add(Vector a, Vector b) {
+			return _mm_add_epi32(a, b);
+		}
+
+		static inline bool any(Vector mask) {
+			return _mm_movemask_epi8(mask);
+		}
+
+		static inline Vector distance(Vector a, Vector b) {
+			const __m128i mask = _mm_set1_epi16(0x00ff);
+
+			__m128i delta = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+			__m128i sum = _mm_add_epi16(_mm_and_si128(delta, mask), _mm_srli_epi16(delta, 8));
+
+			return _mm_add_epi32(_mm_and_si128(sum, _mm_set1_epi32(0xffff)), _mm_srli_epi32(sum, 16));
+		}
+
+		template <int W, int S>
+		static inline Vector mix(Vector a, Vector b) {
+			const __m128i mask = _mm_set1_epi16(0x00ff);
+			const __m128i wa = _mm_set1_epi16((1 << S) - W);
+			const __m128i wb = _mm_set1_epi16(W);
+
+			__m128i rb = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(a, mask), wa), _mm_mullo_epi16(_mm_and_si128(b, mask), wb)), S);
+			__m128i ga = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(a, 8), wa), _mm_mullo_epi16(_mm_srli_epi16(b, 8), wb)), S);
+
+			return _mm_or_si128(rb, _mm_slli_epi16(ga, 8));
+		}
+
+		static inline void store2(uint32_t *p_out, Vector a, Vector b) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&p_out[0]), _mm_unpacklo_epi32(a, b));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&p_out[4]), _mm_unpackhi_epi32(a, b));
+		}
+
+		static inline void store3(uint32_t *p_out, Vector a, Vector b, Vector c) {
+			__m128 ab = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b));
+			__m128 bc = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c));
+			__m128 ca = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a));
+
+			__m128 ab_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b));
+			__m128 bc_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c));
+			__m128 ca_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a));
+
+			_mm_storeu_ps(reinterpret_cast<float*>(&p_out[0]), _mm_shuffle_ps(ab, ca, _MM_SHUFFLE(3, 0, 1, 0)));
+			_mm_storeu_ps(reinterpret_cast<float*>(&p_out[4]), _mm_shuffle_ps(bc, ab_hi, _MM_SHUFFLE(1, 0, 3, 2)));
+			_mm_storeu_ps(reinterpret_cast<float*>(&p_out[8]), _mm_shuffle_ps(ca_hi, bc_hi, _MM_SHUFFLE(3, 2, 3, 0)));
+		}
+	};
+#endif
+
+#if defined(__ARM_NEON)
+	class Neon {
+	public:
+		typedef uint32x4_t Vector;
+
+		static inline Vector load(const uint32_t *p_in) {
+			return vld1q_u32(p_in);
+		}
+
+		static inline Vector set(uint32_t value) {
+			return vdupq_n_u32(value);
+		}
+
+		static inline Vector equal(Vector a, Vector b) {
+			return vceqq_u32(a, b);
+		}
+
+		static inline Vector less(Vector a, Vector b) {
+			return vcltq_u32(a, b);
+		}
+
+		static inline Vector both(Vector a, Vector b) {
+			return vandq_u32(a, b);
+		}
+
+		static inline Vector either(Vector a, Vector b) {
+			return vorrq_u32(a, b);
+		}
+
+		static inline Vector but(Vector a, Vector b) {
+			return vbicq_u32(a, b);
+		}
+
+		static inline Vector select(Vector mask, Vector a, Vector b) {
+			return vbslq_u32(mask, a, b);
+		}
+
+		static inline Vector add(Vector a, Vector b) {
+			return vaddq_u32(a, b);
+		}
+
+		static inline bool any(Vector mask) {
+			uint64x2_t lanes = vreinterpretq_u64_u32(mask);
+			return vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1);
+		}
+
+		static inline Vector distance(Vector a, Vector b) {
+			return vpaddlq_u16(vpaddlq_u8(vabdq_u8(vreinterpretq_u8_u32(a), vreinterpretq_u8_u32(b))));
+		}
+
+		template <int W, int S>
+		static inline Vector mix(Vector a, Vector b) {
+			uint8x16_t a8 = vreinterpretq_u8_u32(a);
+			uint8x16_t b8 = vreinterpretq_u8_u32(b);
+
+			uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a8), vdup_n_u8((1 << S) - W)), vget_low_u8(b8), vdup_n_u8(W));
+			uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a8), vdup_n_u8((1 << S) - W)), vget_high_u8(b8), vdup_n_u8(W));
+
+			return vreinterpretq_u32_u8(vcombine_u8(vshrn_n_u16(lo, S), vshrn_n_u16(hi, S)));
+		}
+
+		static inline void store2(uint32_t *p_out, Vector a, Vector b) {
+			uint32x4x2_t out = { { a, b } };
+			vst2q_u32(p_out, out);
+		}
+
+		static inline void store3(uint32_t *p_out, Vector a, Vector b, Vector c) {
+			uint32x4x3_t out = { { a, b, c } };
+			vst3q_u32(p_out, out);
+		}
+	};
+#endif
+
+	std::vector<uint32_t> m_yuv;
+
+	std::vector<std::thread> m_workers;
+	int m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+
+	uint64_t m_generation = 0;
+	int m_pending = 0;
+	bool m_stopping = false;
+
+	Scaler::Stage m_stage;
+	Scaler::Filter m_filter;
+
+	UCHAR *m_in;
+	uint32_t *m_out;
+
+	int m_begin;
+	int m_end;
+
+	static constexpr int turn(int index, int size, int turns) {
+		int row = index / size;
+		int col = index % size;
+
+		for (int i = 0; i < turns; ++i) {
+			int turned = row;
+
+			row = size - 1 - col;
+			col = turned;
+		}
+
+		return row * size + col;
+	}
+
+	static inline uint32_t mix(uint32_t a, uint32_t b, uint32_t c, int wa, int wb, int wc, int shift) {
+		uint32_t rb = ((a & 0x00ff00ff) * wa + (b & 0x00ff00ff) * wb + (c & 0x00ff00ff) * wc) >> shift & 0x00ff00ff;
+		uint32_t ga = ((a >> 8 & 0x00ff00ff) * wa + (b >> 8 & 0x00ff00ff) * wb + (c >> 8 & 0x00ff00ff) * wc) >> shift & 0x00ff00ff;
+
+		return rb | ga << 8;
+	}
+
+	static inline uint32_t mix(uint32_t a, uint32_t b, int weight, int shift) {
+		return Scaler::mix(a, b, b, (1 << shift) - weight, weight, 0, shift);
+	}
+
+	static inline bool differ(uint32_t a, uint32_t b) {
+		return std::abs(static_cast<int>(a >> 16) - static_cast<int>(b >> 16)) > SCALER_HQ_Y || std::abs(static_cast<int>(a >> 8 & 0xff) - static_cast<int>(b >> 8 & 0xff)) > SCALER_HQ_U || std::abs(static_cast<int>(a & 0xff) - static_cast<int>(b & 0xff)) > SCALER_HQ_V;
+	}
+
+	static inline uint32_t distance(uint32_t a, uint32_t b) {
+		return std::abs(static_cast<int>(a >> 16) - static_cast<int>(b >> 16)) + std::abs(static_cast<int>(a >> 8 & 0xff) - static_cast<int>(b >> 8 & 0xff)) + std::abs(static_cast<int>(a & 0xff) - static_cast<int>(b & 0xff));
+	}
+
+	static inline void scale2x(const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end) {
+		uint32_t *p_next = p_out + 2 * CAP_WIDTH;
+
+		for (int x = begin; x < end; ++x) {
+			uint32_t b = p_b[x], e = p_e[x], h = p_h[x];
+			uint32_t d = p_e[x ? x - 1 : x], f = p_e[x < CAP_WIDTH - 1 ? x + 1 : x];
+
+			bool edge = b != h && d != f;
+
+			p_out[2 * x + 0] = edge && d == b ? d : e;
+			p_out[2 * x + 1] = edge && b == f ? f : e;
+			p_next[2 * x + 0] = edge && d == h ? d : e;
+			p_next[2 * x + 1] = edge && h == f ? f : e;
+		}
+	}
+
+	static inline void scale3x(const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end) {
+		uint32_t *p_mid = p_out + 3 * CAP_WIDTH;
+		uint32_t *p_next = p_out + 6 * CAP_WIDTH;
+
+		for (int x = begin; x < end; ++x) {
+			int l = x ? x - 1 : x;
+			int r = x < CAP_WIDTH - 1 ? x + 1 : x;
+
+			uint32_t a = p_b[l], b = p_b[x], c = p_b[r];
+			uint32_t d = p_e[l], e = p_e[x], f = p_e[r];
+			uint32_t g = p_h[l], h = p_h[x], i = p_h[r];
+
+			bool edge = b != h && d != f;
+
+			bool db = edge && d == b;
+			bool bf = edge && b == f;
+			bool dh = edge && d == h;
+			bool hf = edge && h == f;
+
+			p_out[3 * x + 0] = db ? d : e;
+			p_out[3 * x + 1] = (db && e != c) || (bf && e != a) ? b : e;
+			p_out[3 * x + 2] = bf ? f : e;
+			p_mid[3 * x + 0] = (db && e != g) || (dh && e != a) ? d : e;
+			p_mid[3 * x + 1] = e;
+			p_mid[3 * x + 2] = (bf && e != i) || (hf && e != c) ? f : e;
+			p_next[3 * x + 0] = dh ? d : e;
+			p_next[3 * x + 1] = (dh && e != i) || (hf && e != g) ? h : e;
+			p_next[3 * x + 2] = hf ? f : e;
+		}
+	}
+
+	template <typename V>
+	static inline void scale2x_vector(const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end) {
+		typedef typename V::Vector Vector;
+
+		uint32_t *p_next = p_out + 2 * CAP_WIDTH;
+
+		int x = std::max(begin, 1);
+		Scaler::scale2x(p_b, p_e, p_h, p_out, begin, x);
+
+		for (; x + 4 <= end && x + 5 <= CAP_WIDTH; x += 4) {
+			Vector b = V::load(&p_b[x]);
+			Vector d = V::load(&p_e[x - 1]);
+			Vector e = V::load(&p_e[x]);
+			Vector f = V::load(&p_e[x + 1]);
+			Vector h = V::load(&p_h[x]);
+
+			Vector flat = V::either(V::equal(b, h), V::equal(d, f));
+
+			V::store2(&p_out[2 * x], V::select(V::but(V::equal(d, b), flat), d, e), V::select(V::but(V::equal(b, f), flat), f, e));
+			V::store2(&p_next[2 * x], V::select(V::but(V::equal(d, h), flat), d, e), V::select(V::but(V::equal(h, f), flat), f, e));
+		}
+
+		Scaler::scale2x(p_b, p_e, p_h, p_out, x, end);
+	}
+
+	template <typename V>
+	static inline void scale3x_vector(const uint32_t *p_b, const uint32_t *p_e, const uint32_t *p_h, uint32_t *p_out, int begin, int end) {
+		typedef typename V::Vector Vector;
+
+		uint32_t *p_mid = p_out + 3 * CAP_WIDTH;
+		uint32_t *p_next = p_out + 6 * CAP_WIDTH;
+
+		int x = std::max(begin, 1);
+		Scaler::scale3x(p_b, p_e, p_h, p_out, begin, x);
+
+		for (; x + 4 <= end && x + 5 <= CAP_WIDTH; x += 4) {
+			Vector a = V::load(&p_b[x - 1]);
+			Vector b = V::load(&p_b[x]);
+			Vector c = V::load(&p_b[x + 1]);
+			Vector d = V::load(&p_e[x - 1]);
+			Vector e = V::load(&p_e[x]);
+			Vector f = V::load(&p_e[x + 1]);
+			Vector g = V::load(&p_h[x - 1]);
+			Vector h = V::load(&p_h[x]);
+			Vector i = V::load(&p_h[x + 1]);
+
+			Vector flat = V::either(V::equal(b, h), V::equal(d, f));
+
+			Vector db = V::but(V::equal(d, b), flat);
+			Vector bf = V::but(V::equal(b, f), flat);
+			Vector dh = V::but(V::equal(d, h), flat);
+			Vector hf = V::but(V::equal(h, f), flat);
+
+			Vector ea = V::equal(e, a);
+			Vector ec = V::equal(e, c);
+			Vector eg = V::equal(e, g);
+			Vector ei = V::equal(e, i);
+
+			V::store3(&p_out[3 * x], V::select(db, d, e), V::select(V::either(V::but(db, ec), V::but(bf, ea)), b, e), V::select(bf, f, e));
+			V::store3(&p_mid[3 * x], V::select(V::either(V::but(db, eg), V::but(dh, ea)), d, e), e, V::select(V::either(V::but(bf, ei), V::but(hf, ec)), f, e));
+			V::store3(&p_next[3 * x], V::select(dh, d, e), V::select(V::either(V::but(dh, ei), V::but(hf, eg)), h, e), V::select(hf, f, e));
+		}
+
+		Scaler::scale3x(p_b, p_e, p_h, p_out, x, end);
+	}
+
+	static inline uint32_t corner(const uint32_t *p_p, const uint32_t *p_y, int a, int b, int d) {
+		if (!Scaler::differ(p_y[b], p_y[d]) && Scaler::differ(p_y[4], p_y[b])) {
+			return Scaler::differ(p_y[a], p_y[b]) ? Scaler::mix(p_p[4], p_p[b], p_p[d], 2, 1, 1, 2) : Scaler::mix(p_p[4], p_p[b], p_p[d], 2, 3, 3, 3);
+		}
+
+		if (Scaler::differ(p_y[4], p_y[a]) && !Scaler::differ(p_y[4], p_y[b]) && !Scaler::differ(p_y[4], p_y[d])) {
+			return Scaler::mix(p_p[4], p_p[a], 1, 2);
+		}
+
+		return p_p[4];
+	}
+
+	static inline void hq2x(const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], uint32_t *p_out) {
+		uint32_t *p_next = p_out + 2 * CAP_WIDTH;
+
+		for (int x = 0; x < CAP_WIDTH; ++x) {
+			uint32_t p[9];
+			uint32_t q[9];
+
+			bool flat = true;
+
+			for (int i = 0; i < 9; ++i) {
+				p[i] = p_p[i / 3 + 1][x + i % 3 + 1];
+				flat &= p[i] == p[0];
+			}
+
+			if (flat) {
+				p_out[2 * x + 0] = p_out[2 * x + 1] = p_next[2 * x + 0] = p_next[2 * x + 1] = p[4];
+				continue;
+			}
+
+			for (int i = 0; i < 9; ++i) {
+				q[i] = p_y[i / 3 + 1][x + i % 3 + 1];
+			}
+
+			p_out[2 * x + 0] = Scaler::corner(p, q, 0, 1, 3);
+			p_out[2 * x + 1] = Scaler::corner(p, q, 2, 1, 5);
+			p_next[2 * x + 0] = Scaler::corner(p, q, 6, 7, 3);
+			p_next[2 * x + 1] = Scaler::corner(p, q, 8, 7, 5);
+		}
+	}
+
+	template <int T, int N>
+	static inline void edge(const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], int x, uint32_t *p_block) {
+		constexpr int e = Scaler::turn(12, 5, T), f = Scaler::turn(13, 5, T), h = Scaler::turn(17, 5, T), i = Scaler::turn(18, 5, T);
+		constexpr int b = Scaler::turn(7, 5, T), c = Scaler::turn(8, 5, T), d = Scaler::turn(11, 5, T), g = Scaler::turn(16, 5, T);
+		constexpr int f4 = Scaler::turn(14, 5, T), h5 = Scaler::turn(22, 5, T), i4 = Scaler::turn(19, 5, T), i5 = Scaler::turn(23, 5, T);
+
+		auto pixel = [&](int index) { return p_p[index / 5][x + index % 5]; };
+		auto df = [&](int m, int n) { return Scaler::distance(p_y[m / 5][x + m % 5], p_y[n / 5][x + n % 5]); };
+		auto eq = [&](int m, int n) { return df(m, n) < SCALER_XBR_EQUAL; };
+
+		if (pixel(e) == pixel(h) || pixel(e) == pixel(f)) {
+			return;
+		}
+
+		uint32_t wd1 = df(e, c) + df(e, g) + df(i, h5) + df(i, f4) + (df(h, f) << 2);
+		uint32_t wd2 = df(h, d) + df(h, i5) + df(f, i4) + df(f, b) + (df(e, i) << 2);
+
+		if (wd1 > wd2) {
+			return;
+		}
+
+		uint32_t px = df(e, f) <= df(e, h) ? pixel(f) : pixel(h);
+
+		bool line = N == 2 ? (!eq(f, b) && !eq(h, d)) || (eq(e, i) && !eq(f, i4) && !eq(h, i5)) : (!eq(f, b) && !eq(f, c)) || (!eq(h, d) && !eq(h, g)) || (eq(e, i) && ((!eq(f, f4) && !eq(f, i4)) || (!eq(h, h5) && !eq(h, i5))));
+
+		uint32_t &corner = p_block[Scaler::turn(N * N - 1, N, T)];
+
+		if (wd1 == wd2 || !(line || eq(e, g) || eq(e, c))) {
+			corner = Scaler::mix(corner, px, 1, 1);
+			return;
+		}
+
+		uint32_t ke = df(f, g);
+		uint32_t ki = df(h, c);
+
+		bool left = ke << 1 <= ki && pixel(e) != pixel(g) && pixel(d) != pixel(g);
+		bool up = ke >= ki << 1 && pixel(e) != pixel(c) && pixel(b) != pixel(c);
+
+		if constexpr (N == 2) {
+			uint32_t &n1 = p_block[Scaler::turn(1, N, T)];
+			uint32_t &n2 = p_block[Scaler::turn(2, N, T)];
+
+			if (left && up) {
+				corner = Scaler::mix(corner, px, 7, 3);
+				n2 = n1 = Scaler::mix(n2, px, 1, 2);
+			}
+
+			else if (left) {
+				corner = Scaler::mix(corner, px, 3, 2);
+				n2 = Scaler::mix(n2, px, 1, 2);
+			}
+
+			else if (up) {
+				corner = Scaler::mix(corner, px, 3, 2);
+				n1 = Scaler::mix(n1, px, 1, 2);
+			}
+
+			else {
+				corner = Scaler::mix(corner, px, 1, 1);
+			}
+		}
+
+		else {
+			uint32_t &n2 = p_block[Scaler::turn(2, N, T)];
+			uint32_t &n5 = p_block[Scaler::turn(5, N, T)];
+			uint32_t &n6 = p_block[Scaler::turn(6, N, T)];
+			uint32_t &n7 = p_block[Scaler::turn(7, N, T)];
+
+			if (left && up) {
+				n7 = n5 = Scaler::mix(n7, px, 3, 2);
+				n6 = n2 = Scaler::mix(n6, px, 1, 2);
+				corner = px;
+			}
+
+			else if (left) {
+				n7 = Scaler::mix(n7, px, 3, 2);
+				n5 = Scaler::mix(n5, px, 1, 2);
+				n6 = Scaler::mix(n6, px, 1, 2);
+				corner = px;
+			}
+
+			else if (up) {
+				n5 = Scaler::mix(n5, px, 3, 2);
+				n7 = Scaler::mix(n7, px, 1, 2);
+				n2 = Scaler::mix(n2, px, 1, 2);
+				corner = px;
+			}
+
+			else {
+				corner = Scaler::mix(corner, px, 7, 3);
+				n5 = Scaler::mix(n5, px, 1, 3);
+				n7 = Scaler::mix(n7, px, 1, 3);
+			}
+		}
+	}
+
+	template <int N>
+	static inline void xbr(const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], uint32_t *p_out) {
+		for (int x = 0; x < CAP_WIDTH; ++x) {
+			uint32_t e = p_p[2][x + 2];
+			uint32_t block[N * N];
+
+			std::fill(block, block + N * N, e);
+
+			if (p_p[1][x + 2] != e || p_p[3][x + 2] != e || p_p[2][x + 1] != e || p_p[2][x + 3] != e) {
+				Scaler::edge<0, N>(p_p, p_y, x, block);
+				Scaler::edge<1, N>(p_p, p_y, x, block);
+				Scaler::edge<2, N>(p_p, p_y, x, block);
+				Scaler::edge<3, N>(p_p, p_y, x, block);
+			}
+
+			for (int i = 0; i < N; ++i) {
+				memcpy(&p_out[i * CAP_WIDTH * N + x * N], &block[i * N], N * sizeof(uint32_t));
+			}
+		}
+	}
+
+	template <typename V, int T, int N>
+	static inline void edge_vector(const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], int x, typename V::Vector *p_block) {
+		typedef typename V::Vector Vector;
+
+		constexpr int e = Scaler::turn(12, 5, T), f = Scaler::turn(13, 5, T), h = Scaler::turn(17, 5, T), i = Scaler::turn(18, 5, T);
+		constexpr int b = Scaler::turn(7, 5, T), c = Scaler::turn(8, 5, T), d = Scaler::turn(11, 5, T), g = Scaler::turn(16, 5, T);
+		constexpr int f4 = Scaler::turn(14, 5, T), h5 = Scaler::turn(22, 5, T), i4 = Scaler::turn(19, 5, T), i5 = Scaler::turn(23, 5, T);
+
+		auto pixel = [&](int index) { return V::load(&p_p[index / 5][x + index % 5]); };
+		auto df = [&](int m, int n) { return V::distance(V::load(&p_y[m / 5][x + m % 5]), V::load(&p_y[n / 5][x + n % 5])); };
+		auto eq = [&](int m, int n) { return V::less(df(m, n), V::set(SCALER_XBR_EQUAL)); };
+		auto ne = [&](int m, int n) { return V::but(V::set(0xffffffff), eq(m, n)); };
+
+		Vector pe = pixel(e);
+		Vector live = V::but(V::set(0xffffffff), V::either(V::equal(pe, pixel(h)), V::equal(pe, pixel(f))));
+
+		if (!V::any(live)) {
+			return;
+		}
+
+		Vector hf = df(h, f);
+		Vector ei = df(e, i);
+
+		Vector wd1 = V::add(V::add(V::add(df(e, c), df(e, g)), V::add(df(i, h5), df(i, f4))), V::add(V::add(hf, hf), V::add(hf, hf)));
+		Vector wd2 = V::add(V::add(V::add(df(h, d), df(h, i5)), V::add(df(f, i4), df(f, b))), V::add(V::add(ei, ei), V::add(ei, ei)));
+
+		live = V::but(live, V::less(wd2, wd1));
+
+		if (!V::any(live)) {
+			return;
+		}
+
+		Vector px = V::select(V::less(df(e, h), df(e, f)), pixel(h), pixel(f));
+
+		Vector line = N == 2 ? V::either(V::both(ne(f, b), ne(h, d)), V::both(eq(e, i), V::both(ne(f, i4), ne(h, i5)))) : V::either(V::either(V::both(ne(f, b), ne(f, c)), V::both(ne(h, d), ne(h, g))), V::both(eq(e, i), V::either(V::both(ne(f, f4), ne(f, i4)), V::both(ne(h, h5), ne(h, i5)))));
+		Vector strong = V::both(V::but(live, V::equal(wd1, wd2)), V::either(line, V::either(eq(e, g), eq(e, c))));
+
+		Vector ke = df(f, g);
+		Vector ki = df(h, c);
+
+		Vector left = V::but(V::but(V::but(strong, V::less(ki, V::add(ke, ke))), V::equal(pe, pixel(g))), V::equal(pixel(d), pixel(g)));
+		Vector up = V::but(V::but(V::but(strong, V::less(ke, V::add(ki, ki))), V::equal(pe, pixel(c))), V::equal(pixel(b), pixel(c)));
+
+		Vector corners = V::both(left, up);
+		Vector diagonal = V::but(V::but(strong, left), up);
+
+		Vector &corner = p_block[Scaler::turn(N * N - 1, N, T)];
+
+		if constexpr (N == 2) {
+			Vector &n1 = p_block[Scaler::turn(1, N, T)];
+			Vector &n2 = p_block[Scaler::turn(2, N, T)];
+
+			Vector mixed = V::select(left, V::template mix<1, 2>(n2, px), n2);
+
+			n1 = V::select(corners, mixed, V::select(up, V::template mix<1, 2>(n1, px), n1));
+			n2 = mixed;
+
+			corner = V::select(corners, V::template mix<7, 3>(corner, px), V::select(V::either(left, up), V::template mix<3, 2>(corner, px), V::select(live, V::template mix<1, 1>(corner, px), corner)));
+		}
+
+		else {
+			Vector &n2 = p_block[Scaler::turn(2, N, T)];
+			Vector &n5 = p_block[Scaler::turn(5, N, T)];
+			Vector &n6 = p_block[Scaler::turn(6, N, T)];
+			Vector &n7 = p_block[Scaler::turn(7, N, T)];
+
+			Vector mixed7 = V::select(left, V::template mix<3, 2>(n7, px), V::select(up, V::template mix<1, 2>(n7, px), V::select(diagonal, V::template mix<1, 3>(n7, px), n7)));
+			Vector mixed6 = V::select(left, V::template mix<1, 2>(n6, px), n6);
+
+			n5 = V::select(corners, mixed7, V::select(left, V::template mix<1, 2>(n5, px), V::select(up, V::template mix<3, 2>(n5, px), V::select(diagonal, V::template mix<1, 3>(n5, px), n5))));
+			n2 = V::select(corners, mixed6, V::select(up, V::template mix<1, 2>(n2, px), n2));
+
+			n7 = mixed7;
+			n6 = mixed6;
+
+			corner = V::select(V::either(left, up), px, V::select(diagonal, V::template mix<7, 3>(corner, px), V::select(live, V::template mix<1, 1>(corner, px), corner)));
+		}
+	}
+
+	template <typename V, int N>
+	static inline void xbr_vector(const uint32_t (*p_p)[SCALER_PAD], const uint32_t (*p_y)[SCALER_PAD], uint32_t *p_out) {
+		typedef typename V::Vector Vector;
+
+		for (int x = 0; x < CAP_WIDTH; x += 4) {
+			Vector e = V::load(&p_p[2][x + 2]);
+			Vector block[N * N];
+
+			std::fill(block, block + N * N, e);
+
+			Scaler::edge_vector<V, 0, N>(p_p, p_y, x, block);
+			Scaler::edge_vector<V, 1, N>(p_p, p_y, x, block);
+			Scaler::edge_vector<V, 2, N>(p_p, p_y, x, block);
+			Scaler::edge_vector<V, 3, N>(p_p, p_y, x, block);
+
+			for (int i = 0; i < N; ++i) {
+				if constexpr (N == 2) {
+					V::store2(&p_out[i * CAP_WIDTH * N + x * N], block[i * N], block[i * N + 1]);
+				}
+
+				else {
+					V::store3(&p_out[i * CAP_WIDTH * N + x * N], block[i * N], block[i * N + 1], block[i * N + 2]);
+				}
+			}
+		}
+	}
+
+	void convert(int y) {
+		UCHAR *p_in = &this->m_in[4 * y * CAP_WIDTH];
+		uint32_t *p_yuv = &this->m_yuv[y * CAP_WIDTH];
+
+		for (int x = 0; x < CAP_WIDTH; ++x) {
+			int r = p_in[4 * x + 0];
+			int g = p_in[4 * x + 1];
+			int b = p_in[4 * x + 2];
+
+			uint32_t luma = (77 * r + 150 * g + 29 * b) >> 8;
+			uint32_t u = (-43 * r - 85 * g + 128 * b + 32768) >> 8;
+			uint32_t v = (128 * r - 107 * g - 21 * b + 32768) >> 8;
+
+			p_yuv[x] = luma << 16 | u << 8 | v;
+		}
+	}
+
+	void pad(int y, int lo, int hi, uint32_t (*p_p)[SCALER_PAD], uint32_t (*p_y)[SCALER_PAD]) {
+		const uint32_t *p_in = reinterpret_cast<const uint32_t*>(this->m_in);
+
+		for (int i = 0; i < 5; ++i) {
+			int row = std::clamp(y + i - 2, lo, hi - 1) * CAP_WIDTH;
+
+			memcpy(&p_p[i][2], &p_in[row], CAP_WIDTH * sizeof(uint32_t));
+			memcpy(&p_y[i][2], &this->m_yuv[row], CAP_WIDTH * sizeof(uint32_t));
+
+			p_p[i][0] = p_p[i][1] = p_p[i][2];
+			p_p[i][CAP_WIDTH + 2] = p_p[i][CAP_WIDTH + 3] = p_p[i][CAP_WIDTH + 1];
+
+			p_y[i][0] = p_y[i][1] = p_y[i][2];
+			p_y[i][CAP_WIDTH + 2] = p_y[i][CAP_WIDTH + 3] = p_y[i][CAP_WIDTH + 1];
+		}
+	}
+
+	void filter(int y) {
+		int lo = y < SCALER_SPLIT ? 0 : SCALER_SPLIT;
+		int hi = y < SCALER_SPLIT ? SCALER_SPLIT : CAP_HEIGHT;
+
+		int factor = Scaler::factors[this->m_filter];
+
+		const uint32_t *p_in = reinterpret_cast<const uint32_t*>(this->m_in);
+		uint32_t *p_out = &this->m_out[(y - this->m_begin) * factor * CAP_WIDTH * factor];
+
+		if (this->m_filter == Scaler::Filter::SCALE2X || this->m_filter == Scaler::Filter::SCALE3X) {
+			const uint32_t *p_b = &p_in[std::max(y - 1, lo) * CAP_WIDTH];
+			const uint32_t *p_e = &p_in[y * CAP_WIDTH];
+			const uint32_t *p_h = &p_in[std::min(y + 1, hi - 1) * CAP_WIDTH];
+
+			factor == 2 ? Scaler::p_scale2x(p_b, p_e, p_h, p_out, 0, CAP_WIDTH) : Scaler::p_scale3x(p_b, p_e, p_h, p_out, 0, CAP_WIDTH);
+			return;
+		}
+
+		uint32_t pixels[5][SCALER_PAD];
+		uint32_t yuv[5][SCALER_PAD];
+
+		this->pad(y, lo, hi, pixels, yuv);
+
+		switch (this->m_filter) {
+		case Scaler::Filter::HQ2X:
+			Scaler::hq2x(pixels, yuv, p_out);
+			return;
+
+		case Scaler::Filter::XBR2X:
+			Scaler::p_xbr2x(pixels, yuv, p_out);
+			return;
+
+		default:
+			Scaler::p_xbr3x(pixels, yuv, p_out);
+			return;
+		}
+	}
+
+	void run(int thread) {
+		for (int i = thread; i < SCALER_BANDS; i += this->m_threads) {
+			int begin = this->m_begin + (this->m_end - this->m_begin) * i / SCALER_BANDS;
+			int end = this->m_begin + (this->m_end - this->m_begin) * (i + 1) / SCALER_BANDS;
+
+			for (int y = begin; y < end; ++y) {
+				this->m_stage == Scaler::Stage::CONVERT ? this->convert(y) : this->filter(y);
+			}
+		}
+	}
+
+	void dispatch(Scaler::Stage stage) {
+		this->m_stage = stage;
+
+		if (this->m_threads > 1) {
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+
+			this->m_pending = this->m_threads - 1;
+			++this->m_generation;
+
+			lock.unlock();
+			this->m_start.notify_all();
+		}
+
+		this->run(0);
+
+		if (this->m_threads > 1) {
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+			this->m_done.wait(lock, [&] { return !this->m_pending; });
+		}
+	}
+
+	void work(int thread) {
+		uint64_t generation = 0;
+
+		while (true) {
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+			this->m_start.wait(lock, [&] { return this->m_stopping || this->m_generation != generation; });
+
+			if (this->m_stopping) {
+				return;
+			}
+
+			generation = this->m_generation;
+			lock.unlock();
+
+			this->run(thread);
+			lock.lock();
+
+			if (!--this->m_pending) {
+				this->m_done.notify_one();
+			}
+		}
+	}
+};
+
+class Video {
+public:
+	class Screen {
+	public:
+		enum Type { TOP, BOT, JOINT, SIZE };
+		enum Crop { DEFAULT_3DS, SCALED_DS, NATIVE_DS, COUNT };
+
+		struct State {
+			bool blur = false;
+			Crop crop = Video::Screen::Crop::DEFAULT_3DS;
+			int rotation = 0;
+			double scale = 1.0;
+
+			Scaler::Filter filter = Scaler::Filter::NONE;
+		};
+
+		static inline const int widths[Video::Screen::Crop::COUNT] = { 400, 320, 256 };
+		static inline const int heights[Video::Screen::Crop::COUNT] = { 240, 240, 192 };
+
+		sf::RectangleShape m_in_rect;
+		sf::RenderWindow m_win;
+
+		bool m_blur = false;
+		Crop m_crop = Video::Screen::Crop::DEFAULT_3DS;
+		int m_rotation = 0;
+		double m_scale = 1.0;
+
+		Scaler::Filter m_filter = Scaler::Filter::NONE;
+
+		Screen() {}
+
+		std::string key() {
+			switch (this->m_type) {
+			case Video::Screen::Type::TOP:
+				return "top";
+
+			case Video::Screen::Type::BOT:
+				return "bot";
+
+			case Video::Screen::Type::JOINT:
+				return "joint";
+
+			default:
+				return "";
+			}
+		}
+
+		Video::Screen::State state() {
+			return this->m_state;
+		}
+
+		Video::Screen::State settings() {
+			return { this->m_blur, this->m_crop, this->m_rotation, this->m_scale, this->m_filter };
+		}
+
+		void build(Video *p_video, Video::Screen::Type type, int u, int width, bool visible) {
+			this->m_video = p_video;
+			this->m_type = type;
+
+			this->m_begin = u;
+			this->m_end = type == Video::Screen::Type::JOINT ? CAP_HEIGHT : u + width;
+
+			this->resize(Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], this->height(Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]));
+
+			this->m_in_rect.setTexture(&this->m_video->m_in_tex);
+			this->m_in_rect.setTextureRect(sf::IntRect(0, u, this->m_height, width));
+
+			this->m_in_rect.setSize(sf::Vector2f(this->m_height, width));
+			this->m_in_rect.setOrigin(this->m_height / 2, width / 2);
+
+			this->m_in_rect.setRotation(-90);
+			this->m_in_rect.setPosition(width / 2, this->m_height / 2);
+
+			this->m_size = sf::Vector2i(width, this->m_height);
+			this->m_out_rect.setSize(sf::Vector2f(width, this->m_height));
+
+			this->m_view.reset(sf::FloatRect(0, 0, width, this->m_height));
+
+			if (visible) {
+				this->open();
+			}
+		}
+
+		void reset(Video::Screen::State state) {
+			this->m_state = state;
+
+			this->resize(Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], this->height(Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]));
+
+			this->m_view.setRotation(0);
+
+			this->m_view.setSize(this->m_width, this->m_height);
+			this->m_win.setView(this->m_view);
+
+			if (this->m_state.rotation) {
+				if (this->horizontal()) {
+					std::swap(this->m_width, this->m_height);
+				}
+
+				this->rotate();
+			}
+
+			if (this->m_state.crop) {
+				this->crop();
+			}
+
+			this->move();
+			this->rescale();
+
+			this->m_out_tex.setSmooth(this->m_state.blur);
+		}
+
+		void move() {
+			this->m_in_rect.setPosition(this->m_in_rect.getOrigin().y, this->m_in_rect.getOrigin().x);
+
+			switch (this->m_type) {
+			case Video::Screen::Type::TOP:
+				if (this->m_video->m_state.split) {
+					this->m_in_rect.move(0, (Video::Screen::heights[this->m_state.crop] - Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]) / 2);
+				}
+
+				return;
+
+			case Video::Screen::Type::BOT:
+				if (this->m_video->m_state.split) {
+					this->m_in_rect.move(0, (Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS] - Video::Screen::heights[this->m_state.crop]) / 2);
+				}
+
+				else {
+					this->m_in_rect.move((Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS] - Video::Screen::widths[Video::Screen::Crop::SCALED_DS]) / 2, Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS]);
+				}
+
+				return;
+			}
+		}
+
+		void poll() {
+			sf::Event events[EVENT_COUNT];
+			int count = 0;
+
+			{
+				std::lock_guard<std::mutex> lock(this->m_video->m_window);
+
+				while (count < EVENT_COUNT && this->m_win.pollEvent(events[count])) {
+					++count;
+				}
+			}
+
+			for (int i = 0; i < count; ++i) {
+				this->handle(events[i]);
+			}
+		}
+
+		void fit() {
+			sf::Vector2u size = this->extent();
+
+			if (this->m_win.isOpen() && this->m_win.getSize() != size) {
+				this->m_win.setSize(size);
+			}
+		}
+
+		void toggle() {
+			this->m_win.isOpen() ? this->m_win.close() : this->open();
+		}
+
+		void scale(UCHAR *p_buf) {
+			if (this->m_state.filter) {
+				Scaler::p_scaler->scale(this->m_state.filter, p_buf, this->m_scaled.data(), this->m_begin, this->m_end);
+				this->m_scaled_tex.update(reinterpret_cast<sf::Uint8*>(this->m_scaled.data()));
+			}
+		}
+
+		void draw() {
+			this->m_out_tex.clear();
+			this->blit(&this->m_in_rect);
+			this->m_out_tex.display();
+
+			this->m_video->m_shader.setUniform("u_brightness", this->m_video->m_state.brightness * 0.01f);
+
+			this->m_win.clear();
+			this->m_win.draw(this->m_out_rect, &this->m_video->m_shader);
+
+			this->label();
+			this->m_win.display();
+		}
+
+		void draw(sf::RectangleShape *p_top_rect, sf::RectangleShape *p_bot_rect) {
+			this->m_out_tex.clear();
+			this->blit(p_top_rect);
+			this->blit(p_bot_rect);
+			this->m_out_tex.display();
+
+			this->m_video->m_shader.setUniform("u_brightness", this->m_video->m_state.brightness * 0.01f);
+
+			this->m_win.clear();
+			this->m_win.draw(this->m_out_rect, &this->m_video->m_shader);
+
+			this->label();
+			this->m_win.display();
+		}
+
+	private:
+		Video *m_video;
+
+		sf::RenderTexture m_out_tex;
+		sf::RectangleShape m_out_rect;
+
+		sf::View m_view;
+
+		Screen::Type m_type;
+		Screen::State m_state;
+
+		int m_width = 0;
+		int m_height = 0;
+
+		sf::Vector2i m_size;
+
+		sf::Texture m_scaled_tex;
+		std::vector<uint32_t> m_scaled;
+
+		int m_factor = 0;
+
+		int m_begin = 0;
+		int m_end = 0;
+
+		void handle(const sf::Event &event) {
+			switch (event.type) {
+			case sf::Event::Closed:
+				g_running = false;
+				break;
+
+			case sf::Event::Resized:
+				this->m_video->publish();
+				break;
+
+			case sf::Event::GainedFocus:
+				Capture::selected = this->m_video->m_capture->m_id;
+				break;
+
+			case sf::Event::KeyPressed:
+				switch (event.key.code) {
+				case sf::Keyboard::Dash:
+					this->m_video->m_brightness = this->m_video->m_brightness > 55 ? this->m_video->m_brightness / 5 * 5 - 5 : 50;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::Equal:
+					this->m_video->m_brightness = this->m_video->m_brightness < 145 ? this->m_video->m_brightness / 5 * 5 + 5 : 150;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::Down:
+					this->m_scale = this->m_scale > 1.5 ? static_cast<int>(this->m_scale / 0.5) * 0.5 - 0.5 : 1.0;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::Up:
+					this->m_scale = this->m_scale < 4.0 ? static_cast<int>(this->m_scale / 0.5) * 0.5 + 0.5 : 4.5;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::Left:
+					this->m_rotation = ((this->m_rotation / 90 * 90 + 90) % 360 + 360) % 360;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::Right:
+					this->m_rotation = ((this->m_rotation / 90 * 90 - 90) % 360 + 360) % 360;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::LBracket:
+					this->m_crop = static_cast<Crop>(((this->m_crop - 1) % Video::Screen::Crop::COUNT + Video::Screen::Crop::COUNT) % Video::Screen::Crop::COUNT);
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::RBracket:
+					this->m_crop = static_cast<Crop>(((this->m_crop + 1) % Video::Screen::Crop::COUNT + Video::Screen::Crop::COUNT) % Video::Screen::Crop::COUNT);
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::Comma:
+					Audio::volume = Audio::volume > 5 ? Audio::volume / 5 * 5 - 5 : 0;
+					Audio::adjust();
+
+					break;
+
+				case sf::Keyboard::Period:
+					Audio::volume = Audio::volume < 95 ? Audio::volume / 5 * 5 + 5 : 100;
+					Audio::adjust();
+
+					break;
+
+				case sf::Keyboard::PageUp:
+					this->m_video->m_capture->m_source->seek(event.key.shift ? -1 : -REPLAY_SEEK, false);
+					break;
+
+				case sf::Keyboard::PageDown:
+					this->m_video->m_capture->m_source->seek(event.key.shift ? 1 : REPLAY_SEEK, false);
+					break;
+
+				case sf::Keyboard::Home:
+					this->m_video->m_capture->m_source->seek(0, true);
+					break;
+				}
+
+				break;
+
+			case sf::Event::KeyReleased:
+				switch (event.key.code) {
+				case sf::Keyboard::Escape:
+					if (!Capture::auto_connect) {
+						Capture *p_capture = this->m_video->m_capture;
+						p_capture->m_connected ? p_capture->m_disconnecting = true : p_capture->m_connecting = true;
+					}
+
+					break;
+
+				case sf::Keyboard::Num0:
+					this->m_video->m_brightness = 100;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::Tab:
+					this->m_video->m_split ^= true;
+					this->m_video->init();
+
+					break;
+
+				case sf::Keyboard::B:
+					this->m_blur ^= true;
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::U:
+					this->m_filter = static_cast<Scaler::Filter>((this->m_filter + 1) % Scaler::Filter::COUNT);
+					this->m_video->publish();
+
+					break;
+
+				case sf::Keyboard::M:
+					Audio::mute ^= true;
+					Audio::adjust();
+
+					break;
+
+				case sf::Keyboard::R:
+					Recorder::toggle(this->m_video->m_capture->m_id);
+					break;
+
+				case sf::Keyboard::A:
+					Soundtrack::toggle(this->m_video->m_capture->m_id);
+					break;
+
+				case sf::Keyboard::Space:
+					this->m_video->m_capture->m_source->pause();
+					break;
+
+				case sf::Keyboard::N:
+					this->m_video->m_capture->m_source->step();
+					break;
+
+				case sf::Keyboard::L:
+					Latency::print();
+					break;
+
+				case sf::Keyboard::O:
+					this->m_video->toggle();
+					break;
+
+				case sf::Keyboard::P:
+					this->m_video->m_shot = this->m_type;
+					this->m_video->m_shots = Video::burst;
+
+					break;
+
+				case sf::Keyboard::F1:
+				case sf::Keyboard::F2:
+				case sf::Keyboard::F3:
+				case sf::Keyboard::F4:
+				case sf::Keyboard::F5:
+				case sf::Keyboard::F6:
+				case sf::Keyboard::F7:
+				case sf::Keyboard::F8:
+				case sf::Keyboard::F9:
+				case sf::Keyboard::F10:
+				case sf::Keyboard::F11:
+				case sf::Keyboard::F12:
+					if (!g_safe_mode) {
+						if (event.key.control) {
+							Video::p_save(this->m_video, CONF_DIR + "presets/", "layout" + std::to_string(event.key.code - sf::Keyboard::F1 + 1) + ".conf");
+						}
+
+						else {
+							Video::p_load(this->m_video, CONF_DIR + "presets/", "layout" + std::to_string(event.key.code - sf::Keyboard::F1 + 1) + ".conf");
+
+							Audio::adjust();
+							this->m_video->init();
+						}
+					}
+
+					break;
+				}
+
+				break;
+			}
+		}
+
+		bool horizontal() {
+			return this->m_state.rotation / 10 % 2;
+		}
+
+		void label() {
+			if (this->m_video->m_state.overlay) {
+				this->m_win.setView(this->m_win.getDefaultView());
+				this->m_win.draw(this->m_video->m_text);
+				this->m_win.setView(this->m_view);
+			}
+		}
+
+		int height(int height) {
+			return height * (this->m_type == Video::Screen::Type::JOINT ? 2 : 1);
+		}
+
+		sf::Vector2u extent() {
+			int width = Video::Screen::widths[this->m_crop];
+			int height = this->height(Video::Screen::heights[this->m_crop]);
+
+			if (this->m_rotation / 10 % 2) {
+				std::swap(width, height);
+			}
+
+			return sf::Vector2u(width * this->m_scale, height * this->m_scale);
+		}
+
+		std::string title() {
+			switch (this->m_type) {
+			case Video::Screen::Type::TOP:
+				return this->m_video->m_name + "-top";
+
+			case Video::Screen::Type::BOT:
+				return this->m_video->m_name + "-bot";
+
+			default:
+				return this->m_video->m_name;
+			}
+		}
+
+		void resize(int width, int height) {
+			this->m_width = width;
+			this->m_height = height;
+		}
+
+		void open() {
+			this->m_win.create(sf::VideoMode(this->extent().x, this->extent().y), this->title());
+
+			this->m_win.setVerticalSyncEnabled(Video::vsync);
+			this->m_win.setActive(false);
+		}
+
+		void rotate() {
+			this->m_view.setRotation(this->m_state.rotation);
+
+			this->m_view.setSize(this->m_width, this->m_height);
+			this->m_win.setView(this->m_view);
+		}
+
+		void crop() {
+			this->horizontal() ? this->resize(this->height(Video::Screen::heights[this->m_state.crop]), Video::Screen::widths[this->m_state.crop]) : this->resize(Video::Screen::widths[this->m_state.crop], this->height(Video::Screen::heights[this->m_state.crop]));
+
+			this->m_view.setSize(this->m_width, this->m_height);
+			this->m_win.setView(this->m_view);
+		}
+
+		void rescale() {
+			int factor = Scaler::factors[this->m_state.filter];
+
+			if (this->m_state.filter && !Scaler::p_scaler) {
+				Scaler::p_scaler = new Scaler(std::thread::hardware_concurrency());
+			}
+
+			if (factor == this->m_factor) {
+				return;
+			}
+
+			this->m_factor = factor;
+
+			this->m_out_tex.create(this->m_size.x * factor, this->m_size.y * factor);
+			this->m_out_rect.setTexture(&this->m_out_tex.getTexture(), true);
+
+			this->m_scaled.assign(factor > 1 ? CAP_WIDTH * factor * (this->m_end - this->m_begin) * factor : 0, 0);
+
+			if (factor > 1) {
+				this->m_scaled_tex.create(CAP_WIDTH * factor, (this->m_end - this->m_begin) * factor);
+			}
+		}
+
+		void blit(sf::RectangleShape *p_rect) {
+			if (!this->m_state.filter) {
+				this->m_out_tex.draw(*p_rect, Video::gpu ? &this->m_video->m_remap : nullptr);
+				return;
+			}
+
+			sf::RectangleShape rect = *p_rect;
+			sf::IntRect area = rect.getTextureRect();
+
+			rect.setTexture(&this->m_scaled_tex);
+			rect.setTextureRect(sf::IntRect(area.left * this->m_factor, (area.top - this->m_begin) * this->m_factor, area.width * this->m_factor, area.height * this->m_factor));
+
+			this->m_out_tex.draw(rect, sf::Transform().scale(this->m_factor, this->m_factor));
+		}
+	};
+
+	struct State {
+		int brightness = 100;
+		bool overlay = false;
+		bool split = false;
+
+		Video::Screen::State screens[Video::Screen::Type::SIZE];
+	};
+
+	static inline const std::string frag = \
+		"uniform sampler2D u_tex;" \
+		"uniform float u_brightness;" \
+		"" \
+		"void main() {" \
+		"	gl_FragColor = texture2D(u_tex, gl_TexCoord[0].st) * u_brightness;" \
+		"}";
+
+	static inline const std::string remap_frag = \
+		"uniform sampler2D u_tex;" \
+		"uniform vec2 u_size;" \
+		"" \
+		"void main() {" \
+		"	vec2 pos = floor(gl_TexCoord[0].st * u_size);" \
+		"	float line = pos.y < 80.0 ? pos.y : pos.y < 400.0 ? 81.0 + (pos.y - 80.0) * 2.0 : 80.0 + (pos.y - 400.0) * 2.0;" \
+		"	float texel = floor(pos.x * 0.75);" \
+		"	float phase = pos.x - floor(pos.x * 0.25) * 4.0;" \
+		"" \
+		"	vec4 a = texture2D(u_tex, vec2(texel + 0.5, line + 0.5) / u_size);" \
+		"	vec4 b = texture2D(u_tex, vec2(texel + 1.5, line + 0.5) / u_size);" \
+		"" \
+		"	gl_FragColor = vec4(phase < 0.5 ? a.rgb : phase < 1.5 ? vec3(a.a, b.rg) : phase < 2.5 ? vec3(a.ba, b.r) : a.gba, 1.0);" \
+		"}";
+
+	static inline std::vector<Video*> videos;
+
+	static inline bool gpu = false;
+	static inline bool vsync = false;
+
+	static inline int burst = 1;
+
+	static inline void (*p_load) (Video *p_video, std::string path, std::string name);
+	static inline void (*p_save) (Video *p_video, std::string path, std::string name);
+
+	static inline void (*p_shoot) (Video *p_video, UCHAR *p_buf, Video::Screen::Type type, uint64_t sequence);
+	static inline void (*p_expand) (UCHAR *p_in, UCHAR *p_out, int count);
+
+	Screen m_screens[Video::Screen::Type::SIZE];
+
+	Capture *m_capture;
+	std::string m_name;
+
+	int m_brightness = 100;
+
+	bool m_overlay = false;
+	bool m_split = false;
+
+	std::atomic<uint64_t> m_presented = 0;
+	std::atomic<uint64_t> m_dropped = 0;
+	std::atomic<uint64_t> m_duplicated = 0;
+	std::atomic<uint64_t> m_skipped = 0;
+
+	std::atomic<uint64_t> m_tiles = 0;
+	std::atomic<uint64_t> m_uploads = 0;
+
+	Video(Capture *p_capture) : m_capture(p_capture), m_name(p_capture->m_name) {}
+
+	Screen *screen(std::string key) {
+		if (key == "top") {
+			return &this->m_screens[Video::Screen::Type::TOP];
+		}
+
+		if (key == "bot") {
+			return &this->m_screens[Video::Screen::Type::BOT];
+		}
+
+		if (key == "joint") {
+			return &this->m_screens[Video::Screen::Type::JOINT];
+		}
+
+		return nullptr;
+	}
+
+	static inline void detect() {
+		Video::p_expand = &Video::expand;
+		const char *p_name = "scalar";
+
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2")) {
+			Video::p_expand = &Video::expand_avx2;
+			p_name = "avx2";
+		}
+
+		else if (__builtin_cpu_supports("sse4.1")) {
+			Video::p_expand = &Video::expand_sse41;
+			p_name = "sse4.1";
+		}
+#elif defined(__ARM_NEON)
+		Video::p_expand = &Video::expand_neon;
+		p_name = "neon";
+#endif
+
+		printf("[%s] Using %s map.\n", NAME, p_name);
+
+		Scaler::detect();
+	}
+
+	static inline void bench() {
+		std::vector<std::pair<std::string, void (*) (UCHAR *p_in, UCHAR *p_out, int count)>> kernels = { { "scalar", &Video::expand } };
+
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("sse4.1")) {
+			kernels.emplace_back("sse4.1", &Video::expand_sse41);
+		}
+
+		if (__builtin_cpu_supports("avx2")) {
+			kernels.emplace_back("avx2", &Video::expand_avx2);
+		}
+#elif defined(__ARM_NEON)
+		kernels.emplace_back("neon", &Video::expand_neon);
+#endif
+
+		std::vector<UCHAR> in(BUF_SIZE);
+		std::vector<UCHAR> out(FRAME_SIZE_RGBA);
+		std::vector<UCHAR> ref(FRAME_SIZE_RGBA);
+
+		for (int i = 0; i < BUF_SIZE; ++i) {
+			in[i] = i * 2654435761u >> 24;
+		}
+
+		void (*p_expand) (UCHAR *p_in, UCHAR *p_out, int count) = Video::p_expand;
+
+		for (auto &kernel : kernels) {
+			Video::p_expand = kernel.second;
+			Video::map(in.data(), out.data());
+
+			if (kernel.second == &Video::expand) {
+				memcpy(ref.data(), out.data(), FRAME_SIZE_RGBA);
+			}
+
+			bool match = memcmp(ref.data(), out.data(), FRAME_SIZE_RGBA) == 0;
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < BENCH_COUNT; ++i) {
+				Video::map(in.data(), out.data());
+			}
+
+			auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			Bench::record("map." + kernel.first, time / BENCH_COUNT, "ns/frame", match);
+		}
+
+		Video::p_expand = p_expand;
+	}
+
+	static inline void map(UCHAR *p_in, UCHAR *p_out) {
+		for (int i = 0, j = DELTA_RES, k = TOP_RES; i < CAP_RES; i += CAP_WIDTH) {
+			if (i < DELTA_RES) {
+				Video::p_expand(&p_in[3 * i], &p_out[4 * i], CAP_WIDTH);
+			}
+
+			else if (i / CAP_WIDTH & 1) {
+				Video::p_expand(&p_in[3 * i], &p_out[4 * j], CAP_WIDTH);
+				j += CAP_WIDTH;
+			}
+
+			else {
+				Video::p_expand(&p_in[3 * i], &p_out[4 * k], CAP_WIDTH);
+				k += CAP_WIDTH;
+			}
+		}
+	}
+
+	void init() {
+		{
+			std::scoped_lock lock(this->m_window, this->m_mutex);
+
+			if (!(this->m_screens[Video::Screen::Type::JOINT].m_win.isOpen() ^ this->m_split)) {
+				this->m_screens[Video::Screen::Type::TOP].toggle();
+				this->m_screens[Video::Screen::Type::BOT].toggle();
+				this->m_screens[Video::Screen::Type::JOINT].toggle();
+			}
+		}
+
+		this->publish();
+	}
+
+	void publish() {
+		std::shared_ptr<Video::State> p_state = std::make_shared<Video::State>();
+
+		p_state->brightness = this->m_brightness;
+		p_state->overlay = this->m_overlay;
+		p_state->split = this->m_split;
+
+		for (int i = 0; i < Video::Screen::Type::SIZE; ++i) {
+			p_state->screens[i] = this->m_screens[i].settings();
+		}
+
+		std::atomic_store(&this->m_snapshot, std::shared_ptr<const Video::State>(p_state));
+
+		std::scoped_lock lock(this->m_window, this->m_mutex);
+		this->fit();
+	}
+
+	void create() {
+		this->m_screens[Video::Screen::Type::TOP].build(this, Video::Screen::Type::TOP, 0, Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], this->m_split);
+		this->m_screens[Video::Screen::Type::BOT].build(this, Video::Screen::Type::BOT, Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], Video::Screen::widths[Video::Screen::Crop::SCALED_DS], this->m_split);
+		this->m_screens[Video::Screen::Type::JOINT].build(this, Video::Screen::Type::JOINT, 0, Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], !this->m_split);
+
+		this->m_shader.loadFromMemory(Video::frag, sf::Shader::Fragment);
+
+		Realtime::pin(this->m_buf, sizeof(this->m_buf));
+		Realtime::pin(this->m_last, sizeof(this->m_last));
+
+		if (Video::gpu && !(sf::Shader::isAvailable() && this->m_remap.loadFromMemory(Video::remap_frag, sf::Shader::Fragment))) {
+			printf("[%s] Remap shader failed, using CPU map.\n", NAME);
+			Video::gpu = false;
+		}
+
+		if (Video::gpu) {
+			this->m_in_tex.create(RAW_WIDTH, CAP_HEIGHT);
+
+			this->m_remap.setUniform("u_tex", sf::Shader::CurrentTexture);
+			this->m_remap.setUniform("u_size", sf::Vector2f(RAW_WIDTH, CAP_HEIGHT));
+		}
+
+		else {
+			this->m_in_tex.create(CAP_WIDTH, CAP_HEIGHT);
+		}
+
+		this->init();
+	}
+
+	void close() {
+		this->m_screens[Video::Screen::Type::TOP].m_win.close();
+		this->m_screens[Video::Screen::Type::BOT].m_win.close();
+		this->m_screens[Video::Screen::Type::JOINT].m_win.close();
+	}
+
+	void print() {
+		printf("[%s] Frames presented %llu, dropped %llu, duplicated %llu, source rate %.3f FPS.\n", this->m_name.c_str(), static_cast<unsigned long long>(this->m_presented), static_cast<unsigned long long>(this->m_dropped), static_cast<unsigned long long>(this->m_duplicated), 1000000.0 / this->m_period);
+		printf("[%s] Redraws skipped %llu (%.1f%%), tiles uploaded %.1f%%.\n", this->m_name.c_str(), static_cast<unsigned long long>(this->m_skipped), this->m_presented ? 100.0 * this->m_skipped / this->m_presented : 0.0, this->m_tiles ? 100.0 * this->m_uploads / this->m_tiles : 0.0);
+	}
+
+	void blank() {
+		this->m_shown = 0;
+		memset(this->m_buf, 0x00, FRAME_SIZE_RGBA);
+		Video::gpu ? this->m_in_tex.update(this->m_buf, RAW_WIDTH, CAP_HEIGHT, 0, 0) : this->m_in_tex.update(this->m_buf, CAP_WIDTH, CAP_HEIGHT, 0, 0);
+
+		this->m_fresh = false;
+		std::fill(this->m_changed, this->m_changed + Video::Screen::Type::SIZE, true);
+
+		this->scale();
+
+		this->draw();
+	}
+
+	static inline void run() {
+		while (g_running) {
+			for (Video *p_video : Video::videos) {
+				p_video->poll();
+			}
+
+			sf::sleep(sf::milliseconds(EVENT_TIME));
+		}
+	}
+
+	static inline void render() {
+		Realtime::apply(NAME, Realtime::Thread::RENDER, "Render");
+
+		while (g_running) {
+			uint64_t rings = Capture::rung();
+			bool idle = true;
+
+			for (Video *p_video : Video::videos) {
+				idle &= !p_video->update(Video::videos.size() == 1);
+			}
+
+			if (idle) {
+				Capture::wait(rings, 5);
+			}
+		}
+	}
+
+private:
+	sf::Shader m_shader;
+	sf::Shader m_remap;
+	sf::Texture m_in_tex;
+
+	alignas(16) UCHAR m_buf[FRAME_SIZE_RGBA];
+	UCHAR m_last[FRAME_SIZE_RGB];
+
+	bool m_fresh = false;
+	bool m_tiled[DIRTY_TILES] = {};
+	bool m_changed[Video::Screen::Type::SIZE] = {};
+
+	double m_period = 1000000 / FRAME_RATE;
+	double m_target = 0.0;
+
+	uint64_t m_sequence = 0;
+	sf::Int64 m_time = 0;
+	sf::Int64 m_shown = 0;
+
+	sf::Font m_font;
+	sf::Text m_text;
+	sf::Clock m_clock;
+
+	bool m_loaded = false;
+
+	std::atomic<int> m_shots = 0;
+	std::atomic<Video::Screen::Type> m_shot = Video::Screen::Type::JOINT;
+
+	std::mutex m_mutex;
+	std::mutex m_window;
+
+	std::shared_ptr<const Video::State> m_snapshot;
+	std::shared_ptr<const Video::State> m_current;
+
+	Video::State m_state;
+
+	bool update(bool blocking) {
+		if (!this->m_capture->m_connected) {
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+
+			if (this->apply() || this->m_shown) {
+				this->blank();
+			}
+
+			return false;
+		}
+
+		Capture::Frame frame;
+
+		if (blocking) {
+			this->m_capture->m_video.wait(&frame);
+		}
+
+		else if (!this->m_capture->m_video.pop(&frame)) {
+			return false;
+		}
+
+		if (frame.index == TRANSFER_ABORT) {
+			return true;
+		}
+
+		Latency::record(Latency::Stage::WAKE, frame.time);
+
+		if (frame.starting || !this->m_capture->acquire(frame)) {
+			this->m_capture->discard(frame);
+
+			if (frame.starting) {
+				std::lock_guard<std::mutex> lock(this->m_mutex);
+
+				this->apply();
+				this->blank();
+			}
+
+			return true;
+		}
+
+		if (!this->pace(&frame)) {
+			this->m_capture->release(frame.index);
+			return true;
+		}
+
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->apply();
+
+		if (!this->load(this->m_capture->m_buf[frame.index], &this->m_capture->m_read[frame.index], frame.time)) {
+			this->m_capture->release(frame.index);
+			return true;
+		}
+
+		if (this->m_state.overlay || !(this->m_presented % DIRTY_REFRESH)) {
+			std::fill(this->m_changed, this->m_changed + Video::Screen::Type::SIZE, true);
+		}
+
+		if (this->m_changed[Video::Screen::Type::JOINT]) {
+			this->draw();
+			Latency::record(Latency::Stage::DISPLAY, frame.time);
+		}
+
+		else {
+			++this->m_skipped;
+		}
+
+		this->present();
+
+		if (this->m_presented == 1) {
+			printf("[%s] First frame after %lld ms.\n", this->m_name.c_str(), static_cast<long long>((this->m_shown - Capture::started) / 1000));
+		}
+
+		if (this->m_shots) {
+			--this->m_shots;
+			Video::p_shoot(this, this->m_capture->m_buf[frame.index], this->m_shot, frame.sequence);
+		}
+
+		this->m_capture->release(frame.index);
+
+		return true;
+	}
+
+	bool pace(Capture::Frame *p_frame) {
+		if (this->m_time && p_frame->sequence > this->m_sequence) {
+			double interval = static_cast<double>(p_frame->time - this->m_time) / (p_frame->sequence - this->m_sequence);
+
+			if (interval > 1000000 / PACING_MAX && interval < 1000000 / PACING_MIN) {
+				this->m_period += (interval - this->m_period) * PACING_SMOOTHING;
+			}
+
+			this->m_target += this->m_period * (p_frame->sequence - this->m_sequence);
+		}
+
+		this->m_sequence = p_frame->sequence;
+		this->m_time = p_frame->time;
+
+		double error = p_frame->time + PACING_DELAY - this->m_target;
+		std::abs(error) > this->m_period ? this->m_target = p_frame->time + PACING_DELAY : this->m_target += error * PACING_TRACKING;
+
+		if (Video::vsync) {
+			if (this->m_capture->m_video.size() >= PACING_DEPTH) {
+				++this->m_dropped;
+				return false;
+			}
+
+			return true;
+		}
+
+		sf::Int64 now = Capture::now();
+
+		if (now > this->m_target + this->m_period && this->m_capture->m_video.size()) {
+			++this->m_dropped;
+			return false;
+		}
+
+		if (this->m_target > now && Video::videos.size() == 1) {
+			sf::sleep(sf::microseconds(this->m_target - now));
+		}
+
+		return true;
+	}
+
+	void present() {
+		sf::Int64 now = Capture::now();
+
+		if (this->m_shown) {
+			int repeats = std::lround((now - this->m_shown) / this->m_period) - 1;
+
+			if (repeats > 0) {
+				this->m_duplicated += repeats;
+			}
+		}
+
+		this->m_shown = now;
+		++this->m_presented;
+	}
+
+
+	void toggle() {
+		if (!this->m_overlay) {
+			for (const char *p_path : { "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", "/usr/share/fonts/TTF/DejaVuSansMono.ttf", "/usr/share/fonts/dejavu/DejaVuSansMono.ttf", "/usr/share/fonts/truetype/liberation/LiberationMono-Regular.ttf", "/System/Library/Fonts/Menlo.ttc", "/System/Library/Fonts/Monaco.ttf" }) {
+				if (this->m_loaded || (this->m_loaded = std::filesystem::exists(p_path) && this->m_font.loadFromFile(p_path))) {
+					break;
+				}
+			}
+
+			if (!this->m_loaded) {
+				printf("[%s] Font load failed.\n", NAME);
+				return;
+			}
+		}
+
+		this->m_overlay ^= true;
+		this->publish();
+	}
+
+	void fit() {
+		this->m_screens[Video::Screen::Type::TOP].fit();
+		this->m_screens[Video::Screen::Type::BOT].fit();
+		this->m_screens[Video::Screen::Type::JOINT].fit();
+	}
+
+	bool apply() {
+		std::shared_ptr<const Video::State> p_state = std::atomic_load(&this->m_snapshot);
+
+		if (p_state == this->m_current) {
+			return false;
+		}
+
+		if (p_state->overlay && !this->m_state.overlay) {
+			this->m_text.setFont(this->m_font);
+			this->m_text.setCharacterSize(OVERLAY_SIZE);
+			this->m_text.setFillColor(sf::Color::White);
+			this->m_text.setOutlineColor(sf::Color::Black);
+			this->m_text.setOutlineThickness(1);
+			this->m_text.setString(Latency::text());
+
+			this->m_clock.restart();
+		}
+
+		this->m_current = p_state;
+		this->m_state = *p_state;
+
+		this->m_fresh = false;
+
+		for (int i = 0; i < Video::Screen::Type::SIZE; ++i) {
+			this->m_screens[i].reset(this->m_state.screens[i]);
+		}
+
+		return true;
+	}
+
+	void poll() {
+		this->m_screens[Video::Screen::Type::TOP].poll();
+		this->m_screens[Video::Screen::Type::BOT].poll();
+		this->m_screens[Video::Screen::Type::JOINT].poll();
+	}
+
+	bool load(UCHAR *p_buf, ULONG *p_read, sf::Int64 time) {
+		if (*p_read < FRAME_SIZE_RGB) {
+			return false;
+		}
+
+		this->diff(p_buf);
+		Latency::record(Latency::Stage::MAP, time);
+
+		if (this->scaled()) {
+			this->scale();
+			Latency::record(Latency::Stage::SCALE, time);
 		}
 
-		void draw() {
-			this->m_win.setSize(sf::Vector2u(this->m_width * this->m_scale, this->m_height * this->m_scale));
+		this->upload(p_buf);
+		Latency::record(Latency::Stage::UPLOAD, time);
+
+		return true;
+	}
+
+	void diff(UCHAR *p_in) {
+		bool mapped = !Video::gpu || this->scaled();
+
+		std::fill(this->m_changed, this->m_changed + Video::Screen::Type::SIZE, false);
+
+		for (int i = 0, j = DELTA_RES / CAP_WIDTH, k = TOP_RES / CAP_WIDTH; i < CAP_HEIGHT; ++i) {
+			int line = i < DELTA_RES / CAP_WIDTH ? i : i & 1 ? j++ : k++;
+
+			UCHAR *p_line = &p_in[3 * i * CAP_WIDTH];
+			UCHAR *p_last = &this->m_last[3 * i * CAP_WIDTH];
 
-			this->m_out_tex.clear();
-			this->m_out_tex.draw(this->m_in_rect);
-			this->m_out_tex.display();
+			if (this->m_fresh && !memcmp(p_line, p_last, 3 * CAP_WIDTH)) {
+				continue;
+			}
 
-			Video::shader.setUniform("u_brightness", Video::brightness * 0.01f);
+			memcpy(p_last, p_line, 3 * CAP_WIDTH);
 
-			this->m_win.clear();
-			this->m_win.draw(this->m_out_rect, &Video::shader);
-			this->m_win.display();
+			if (mapped) {
+				Video::p_expand(p_line, &this->m_buf[4 * line * CAP_WIDTH], CAP_WIDTH);
+			}
+
+			this->m_tiled[(Video::gpu ? i : line) / DIRTY_LINES] = true;
+			this->m_changed[line < TOP_RES / CAP_WIDTH ? Video::Screen::Type::TOP : Video::Screen::Type::BOT] = true;
 		}
 
-		void draw(sf::RectangleShape *p_top_rect, sf::RectangleShape *p_bot_rect) {
-			this->m_win.setSize(sf::Vector2u(this->m_width * this->m_scale, this->m_height * this->m_scale));
+		this->m_changed[Video::Screen::Type::JOINT] = this->m_changed[Video::Screen::Type::TOP] || this->m_changed[Video::Screen::Type::BOT];
+		this->m_fresh = true;
+	}
 
-			this->m_out_tex.clear();
-			this->m_out_tex.draw(*p_top_rect);
-			this->m_out_tex.draw(*p_bot_rect);
-			this->m_out_tex.display();
+	void upload(UCHAR *p_in) {
+		this->m_tiles += DIRTY_TILES;
 
-			Video::shader.setUniform("u_brightness", Video::brightness * 0.01f);
+		for (int i = 0; i < DIRTY_TILES;) {
+			if (!this->m_tiled[i]) {
+				++i;
+				continue;
+			}
 
-			this->m_win.clear();
-			this->m_win.draw(this->m_out_rect, &Video::shader);
-			this->m_win.display();
-		}
+			int first = i;
 
-	private:
-		sf::RenderTexture m_out_tex;
-		sf::RectangleShape m_out_rect;
+			while (i < DIRTY_TILES && this->m_tiled[i]) {
+				this->m_tiled[i++] = false;
+			}
 
-		sf::View m_view;
-		sf::Event m_event;
+			int y = first * DIRTY_LINES;
+			int height = std::min(i * DIRTY_LINES, CAP_HEIGHT) - y;
 
-		Screen::Type m_type;
+			Video::gpu ? this->m_in_tex.update(&p_in[3 * y * CAP_WIDTH], RAW_WIDTH, height, 0, y) : this->m_in_tex.update(&this->m_buf[4 * y * CAP_WIDTH], CAP_WIDTH, height, 0, y);
+			this->m_uploads += i - first;
+		}
+	}
 
-		int m_width = 0;
-		int m_height = 0;
+	bool scaled() {
+		return this->m_state.split ? this->m_state.screens[Video::Screen::Type::TOP].filter || this->m_state.screens[Video::Screen::Type::BOT].filter : this->m_state.screens[Video::Screen::Type::JOINT].filter;
+	}
 
-		bool horizontal() {
-			return this->m_rotation / 10 % 2;
+	void scale() {
+		if (this->m_state.split) {
+			if (this->m_changed[Video::Screen::Type::TOP]) {
+				this->m_screens[Video::Screen::Type::TOP].scale(this->m_buf);
+			}
+
+			if (this->m_changed[Video::Screen::Type::BOT]) {
+				this->m_screens[Video::Screen::Type::BOT].scale(this->m_buf);
+			}
 		}
 
-		int height(int height) {
-			return height * (this->m_type == Video::Screen::Type::JOINT ? 2 : 1);
+		else if (this->m_changed[Video::Screen::Type::JOINT]) {
+			this->m_screens[Video::Screen::Type::JOINT].scale(this->m_buf);
 		}
+	}
 
-		std::string title() {
-			switch (this->m_type) {
-			case Video::Screen::Type::TOP:
-				return std::string(NAME) + "-top";
+	static inline void expand(UCHAR *p_in, UCHAR *p_out, int count) {
+		for (int i = 0; i < count; ++i) {
+			p_out[4 * i + 0] = p_in[3 * i + 0];
+			p_out[4 * i + 1] = p_in[3 * i + 1];
+			p_out[4 * i + 2] = p_in[3 * i + 2];
+			p_out[4 * i + 3] = 0xff;
+		}
+	}
 
-			case Video::Screen::Type::BOT:
-				return std::string(NAME) + "-bot";
+#if defined(__x86_64__) || defined(__i386__)
+	__attribute__((target("sse4.1"))) static inline void expand_sse41(UCHAR *p_in, UCHAR *p_out, int count) {
+		const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32(0xff000000);
 
-			default:
-				return NAME;
-			}
+		int i = 0;
+
+		for (; i + 16 <= count; i += 16) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<__m128i*>(&p_in[3 * i + 0]));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<__m128i*>(&p_in[3 * i + 16]));
+			__m128i c = _mm_loadu_si128(reinterpret_cast<__m128i*>(&p_in[3 * i + 32]));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&p_out[4 * i + 0]), _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&p_out[4 * i + 16]), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), alpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&p_out[4 * i + 32]), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask), alpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&p_out[4 * i + 48]), _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), mask), alpha));
 		}
 
-		void resize(int width, int height) {
-			this->m_width = width;
-			this->m_height = height;
+		Video::expand(&p_in[3 * i], &p_out[4 * i], count - i);
+	}
+
+	__attribute__((target("avx2"))) static inline void expand_avx2(UCHAR *p_in, UCHAR *p_out, int count) {
+		const __m256i mask = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m256i alpha = _mm256_set1_epi32(0xff000000);
+
+		int i = 0;
+
+		for (; i + 16 + 2 <= count; i += 16) {
+			__m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i*>(&p_in[3 * i + 0]))), _mm_loadu_si128(reinterpret_cast<__m128i*>(&p_in[3 * i + 12])), 1);
+			__m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i*>(&p_in[3 * i + 24]))), _mm_loadu_si128(reinterpret_cast<__m128i*>(&p_in[3 * i + 36])), 1);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&p_out[4 * i + 0]), _mm256_or_si256(_mm256_shuffle_epi8(a, mask), alpha));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&p_out[4 * i + 32]), _mm256_or_si256(_mm256_shuffle_epi8(b, mask), alpha));
 		}
 
-		void open() {
-			this->m_win.create(sf::VideoMode(this->m_width * this->m_scale, this->m_height * this->m_scale), this->title());
-			this->m_win.setView(this->m_view);
+		Video::expand_sse41(&p_in[3 * i], &p_out[4 * i], count - i);
+	}
+#endif
+
+#if defined(__ARM_NEON)
+	static inline void expand_neon(UCHAR *p_in, UCHAR *p_out, int count) {
+		int i = 0;
 
-			Video::vsync ? this->m_win.setVerticalSyncEnabled(true) : this->m_win.setFramerateLimit(FRAMERATE_LIMIT);
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x3_t rgb = vld3q_u8(&p_in[3 * i]);
+			uint8x16x4_t rgba = { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(0xff) };
+
+			vst4q_u8(&p_out[4 * i], rgba);
 		}
 
-		void rotate() {
-			this->m_view.setRotation(this->m_rotation);
+		Video::expand(&p_in[3 * i], &p_out[4 * i], count - i);
+	}
+#endif
 
-			this->m_view.setSize(this->m_width, this->m_height);
-			this->m_win.setView(this->m_view);
+	void draw() {
+		if (this->m_state.overlay && this->m_clock.getElapsedTime() > sf::milliseconds(OVERLAY_INTERVAL)) {
+			this->m_text.setString(Latency::text());
+			this->m_clock.restart();
 		}
 
-		void crop() {
-			this->horizontal() ? this->resize(this->height(Video::Screen::heights[this->m_crop]), Video::Screen::widths[this->m_crop]) : this->resize(Video::Screen::widths[this->m_crop], this->height(Video::Screen::heights[this->m_crop]));
+		if (this->m_state.split) {
+			if (this->m_changed[Video::Screen::Type::TOP]) {
+				this->m_screens[Video::Screen::Type::TOP].draw();
+			}
 
-			this->m_view.setSize(this->m_width, this->m_height);
-			this->m_win.setView(this->m_view);
+			if (this->m_changed[Video::Screen::Type::BOT]) {
+				this->m_screens[Video::Screen::Type::BOT].draw();
+			}
 		}
+
+		else {
+			this->m_screens[Video::Screen::Type::JOINT].draw(&this->m_screens[Video::Screen::Type::TOP].m_in_rect, &this->m_screens[Video::Screen::Type::BOT].m_in_rect);
+		}
+	}
+};
+
+class Headless {
+public:
+	struct Chunk {
+		uint32_t magic;
+		uint32_t type;
+		uint32_t size;
+		uint32_t format;
+
+		uint32_t width;
+		uint32_t height;
+
+		uint32_t rate;
+		uint32_t channels;
+
+		uint64_t sequence;
+		int64_t time;
 	};
 
-	static inline const std::string frag = \
-		"uniform sampler2D u_tex;" \
-		"uniform float u_brightness;" \
-		"" \
-		"void main() {" \
-		"	gl_FragColor = texture2D(u_tex, gl_TexCoord[0].st) * u_brightness;" \
-		"}";
+	enum Type { VIDEO, AUDIO };
+	enum Format { RGB, RGBA, S16LE };
 
-	static inline Screen screens[Video::Screen::Type::SIZE];
+	static inline bool enabled = false;
+	static inline bool blocking = true;
 
-	static inline sf::Shader shader;
-	static inline sf::Texture in_tex;
+	static inline Headless::Format format = Headless::Format::RGB;
+	static inline Video::Screen::Type layout = Video::Screen::Type::JOINT;
 
-	static inline int brightness = 100;
+	static inline std::string video_path;
+	static inline std::string audio_path;
 
-	static inline bool split = false;
-	static inline bool vsync = false;
+	static inline bool open() {
+		int out = dup(STDOUT_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
 
-	static inline std::promise<int> promise;
-	static inline bool waiting = false;
+		Headless::video_fd = Headless::video_path.empty() ? out : ::open(Headless::video_path.c_str(), O_WRONLY);
+		Headless::audio_fd = Headless::audio_path.empty() ? out : ::open(Headless::audio_path.c_str(), O_WRONLY);
+
+		if (Headless::video_fd < 0 || Headless::audio_fd < 0) {
+			printf("[%s] Output open failed.\n", NAME);
+			return false;
+		}
 
-	static inline void (*p_load) (std::string path, std::string name);
-	static inline void (*p_save) (std::string path, std::string name);
+		for (int fd : { Headless::video_fd, Headless::audio_fd }) {
+#if defined(__linux__)
+			fcntl(fd, F_SETPIPE_SZ, HEADLESS_PIPE);
+#endif
 
-	static inline Screen *screen(std::string key) {
-		if (key == "top") {
-			return &Video::screens[Video::Screen::Type::TOP];
+			if (!Headless::blocking) {
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			}
 		}
 
-		if (key == "bot") {
-			return &Video::screens[Video::Screen::Type::BOT];
+		std::signal(SIGINT, Headless::stop);
+		std::signal(SIGTERM, Headless::stop);
+		std::signal(SIGPIPE, SIG_IGN);
+
+		return true;
+	}
+
+	static inline void run() {
+		Capture *p_capture = Capture::devices[0];
+
+		while (g_running) {
+			if (!p_capture->m_connected) {
+				sf::sleep(sf::milliseconds(5));
+				continue;
+			}
+
+			Capture::Frame frame;
+			p_capture->m_video.wait(&frame);
+
+			if (frame.index == TRANSFER_ABORT) {
+				continue;
+			}
+
+			if (frame.starting || !p_capture->acquire(frame)) {
+				p_capture->discard(frame);
+				continue;
+			}
+
+			Headless::write(p_capture->m_buf[frame.index], p_capture->m_read[frame.index], frame.sequence, frame.time);
+			p_capture->release(frame.index);
 		}
 
-		if (key == "joint") {
-			return &Video::screens[Video::Screen::Type::JOINT];
+		printf("[%s] Headless output stopped, %llu written, %llu dropped.\n", NAME, static_cast<unsigned long long>(Headless::written), static_cast<unsigned long long>(Headless::dropped));
+	}
+
+	static inline void close() {
+		::close(Headless::video_fd);
+
+		if (Headless::audio_fd != Headless::video_fd) {
+			::close(Headless::audio_fd);
 		}
+	}
 
-		return nullptr;
+private:
+	static inline int video_fd = -1;
+	static inline int audio_fd = -1;
+
+	static inline UCHAR buf[400 * 480 * 4];
+
+	static inline uint64_t written = 0;
+	static inline uint64_t dropped = 0;
+
+	static inline void stop(int) {
+		g_running = false;
+	}
+
+	static inline int width() {
+		return Headless::layout == Video::Screen::Type::BOT ? Video::Screen::widths[Video::Screen::Crop::SCALED_DS] : Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS];
+	}
+
+	static inline int height() {
+		return Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS] * (Headless::layout == Video::Screen::Type::JOINT ? 2 : 1);
 	}
 
-	static inline void init() {
-		Video::screens[Video::Screen::Type::TOP].reset();
-		Video::screens[Video::Screen::Type::BOT].reset();
-		Video::screens[Video::Screen::Type::JOINT].reset();
+	static inline void copy(UCHAR *p_in, UCHAR *p_out, int first, int count, int x, int y, int width) {
+		int size = Headless::format == Headless::Format::RGBA ? 4 : 3;
+
+		for (int i = 0; i < count; ++i) {
+			int line = first + i < DELTA_RES / CAP_WIDTH ? first + i : first < 400 ? DELTA_RES / CAP_WIDTH + (first + i - DELTA_RES / CAP_WIDTH) * 2 + 1 : DELTA_RES / CAP_WIDTH + (first + i - 400) * 2;
 
-		if (!(Video::screens[Video::Screen::Type::JOINT].m_win.isOpen() ^ Video::split)) {
-			Video::screens[Video::Screen::Type::TOP].toggle();
-			Video::screens[Video::Screen::Type::BOT].toggle();
-			Video::screens[Video::Screen::Type::JOINT].toggle();
+			UCHAR *p_src = &p_in[line * CAP_WIDTH * 3];
+			UCHAR *p_dst = &p_out[((y + CAP_WIDTH - 1) * width + x + i) * size];
+
+			for (int j = 0; j < CAP_WIDTH; ++j, p_src += 3, p_dst -= width * size) {
+				p_dst[0] = p_src[0];
+				p_dst[1] = p_src[1];
+				p_dst[2] = p_src[2];
+
+				if (size == 4) {
+					p_dst[3] = 0xff;
+				}
+			}
 		}
 	}
 
-	static inline void blank() {
-		memset(Video::buf, 0x00, FRAME_SIZE_RGBA);
-		Video::in_tex.update(Video::buf, CAP_WIDTH, CAP_HEIGHT, 0, 0);
+	static inline void map(UCHAR *p_in, UCHAR *p_out) {
+		int width = Headless::width();
+
+		switch (Headless::layout) {
+		case Video::Screen::Type::TOP:
+			Headless::copy(p_in, p_out, 0, 400, 0, 0, width);
+			return;
+
+		case Video::Screen::Type::BOT:
+			Headless::copy(p_in, p_out, 400, 320, 0, 0, width);
+			return;
+
+		default:
+			Headless::copy(p_in, p_out, 0, 400, 0, 0, width);
+			Headless::copy(p_in, p_out, 400, 320, (400 - 320) / 2, 240, width);
 
-		Video::draw();
+			return;
+		}
 	}
 
-	static inline void render() {
-		while (g_running) {
-			Video::poll();
+	static inline void write(UCHAR *p_buf, ULONG read, uint64_t sequence, int64_t time) {
+		Headless::Chunk chunks[Headless::Type::AUDIO + 1];
+		struct iovec iov[4];
 
-			if (!Capture::connected) {
-				Video::blank();
-				sf::sleep(sf::milliseconds(5));
+		int count = 0;
 
-				continue;
+		if (read >= FRAME_SIZE_RGB) {
+			int size = Headless::width() * Headless::height() * (Headless::format == Headless::Format::RGBA ? 4 : 3);
+
+			if (Headless::layout == Video::Screen::Type::JOINT) {
+				memset(Headless::buf, 0x00, size);
 			}
 
-			Video::promise = std::promise<int>();
-			Video::waiting = true;
+			Headless::map(p_buf, Headless::buf);
 
-			int ready = Video::promise.get_future().get();
+			chunks[Headless::Type::VIDEO] = { HEADLESS_MAGIC, Headless::Type::VIDEO, static_cast<uint32_t>(size), Headless::format, static_cast<uint32_t>(Headless::width()), static_cast<uint32_t>(Headless::height()), 0, 0, sequence, time };
 
-			if (ready == TRANSFER_ABORT) {
-				continue;
+			iov[count++] = { &chunks[Headless::Type::VIDEO], sizeof(Headless::Chunk) };
+			iov[count++] = { Headless::buf, static_cast<std::size_t>(size) };
+		}
+
+		if (read > FRAME_SIZE_RGB) {
+			uint32_t size = std::min<ULONG>(read, BUF_SIZE) - FRAME_SIZE_RGB;
+
+			chunks[Headless::Type::AUDIO] = { HEADLESS_MAGIC, Headless::Type::AUDIO, size, Headless::Format::S16LE, 0, 0, SAMPLE_RATE, AUDIO_CHANNELS, sequence, time };
+
+			if (Headless::audio_fd != Headless::video_fd && count) {
+				Headless::send(Headless::video_fd, iov, count);
+				count = 0;
 			}
 
-			if (Capture::starting) {
-				Video::blank();
-				continue;
+			iov[count++] = { &chunks[Headless::Type::AUDIO], sizeof(Headless::Chunk) };
+			iov[count++] = { &p_buf[FRAME_SIZE_RGB], size };
+		}
+
+		if (count) {
+			Headless::send(iov[0].iov_base == &chunks[Headless::Type::AUDIO] ? Headless::audio_fd : Headless::video_fd, iov, count);
+		}
+	}
+
+	static inline void send(int fd, struct iovec *p_iov, int count) {
+		std::size_t size = 0;
+
+		for (int i = 0; i < count; ++i) {
+			size += p_iov[i].iov_len;
+		}
+
+		ssize_t sent = ::writev(fd, p_iov, count);
+
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			++Headless::dropped;
+			return;
+		}
+
+		while (sent >= 0 && static_cast<std::size_t>(sent) < size) {
+			while (sent >= static_cast<ssize_t>(p_iov->iov_len)) {
+				sent -= p_iov->iov_len;
+				size -= p_iov->iov_len;
+
+				++p_iov;
+				--count;
 			}
 
-			if (!Video::load(Capture::buf[ready], &Capture::read[ready])) {
-				continue;
+			p_iov->iov_base = static_cast<UCHAR*>(p_iov->iov_base) + sent;
+			p_iov->iov_len -= sent;
+			size -= sent;
+
+			struct pollfd poll_fd = { fd, POLLOUT, 0 };
+			poll(&poll_fd, 1, -1);
+
+			sent = ::writev(fd, p_iov, count);
+
+			if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+				sent = 0;
 			}
+		}
+
+		if (sent < 0) {
+			printf("[%s] Output write failed.\n", NAME);
+			g_running = false;
+
+			return;
+		}
+
+		++Headless::written;
+	}
+};
+
+class Screenshot {
+public:
+	struct Job {
+		int slot;
+		int device;
+
+		Video::Screen::Type type;
+		Video::Screen::Crop crop;
+		int rotation;
+
+		uint64_t sequence;
+	};
+
+	static inline std::string dir;
+	static inline Video::Screen::Type layout = Video::Screen::Type::SIZE;
+
+	static inline std::atomic<uint64_t> saved = 0;
+	static inline std::atomic<uint64_t> dropped = 0;
+
+	static inline void take(Video *p_video, UCHAR *p_buf, Video::Screen::Type type, uint64_t sequence) {
+		if (Screenshot::pool.empty()) {
+			Screenshot::pool.resize(static_cast<std::size_t>(SHOT_COUNT) * FRAME_SIZE_RGB);
+
+			for (int i = 0; i < SHOT_COUNT; ++i) {
+				Screenshot::empty.push(i);
+			}
+
+			Screenshot::thread = std::thread(Screenshot::work);
+		}
+
+		int slot;
+
+		if (!Screenshot::empty.pop(&slot)) {
+			++Screenshot::dropped;
+			return;
+		}
+
+		memcpy(&Screenshot::pool[static_cast<std::size_t>(slot) * FRAME_SIZE_RGB], p_buf, FRAME_SIZE_RGB);
+
+		if (Screenshot::layout != Video::Screen::Type::SIZE) {
+			Screenshot::full.push({ slot, p_video->m_capture->m_id, Screenshot::layout, Video::Screen::Crop::DEFAULT_3DS, 0, sequence });
+			return;
+		}
+
+		Video::Screen::State state = p_video->m_screens[type].state();
+		Screenshot::full.push({ slot, p_video->m_capture->m_id, type, state.crop, state.rotation, sequence });
+	}
 
-			Video::draw();
+	static inline void close() {
+		if (!Screenshot::thread.joinable()) {
+			return;
 		}
+
+		Screenshot::full.push({ SHOT_STOP, 0, Video::Screen::Type::JOINT, Video::Screen::Crop::DEFAULT_3DS, 0, 0 });
+		Screenshot::thread.join();
+
+		printf("[%s] Screenshots saved %llu, dropped %llu.\n", NAME, static_cast<unsigned long long>(Screenshot::saved), static_cast<unsigned long long>(Screenshot::dropped));
 	}
 
 private:
-	static inline UCHAR buf[FRAME_SIZE_RGBA];
+	static inline std::vector<UCHAR> pool;
+
+	static inline Queue<int, SHOT_COUNT> empty;
+	static inline Queue<Screenshot::Job, SHOT_COUNT * 2> full;
+
+	static inline std::thread thread;
+
+	static inline void work() {
+		std::filesystem::create_directories(Screenshot::dir);
 
-	static inline void swap() {
-		Video::screens[Video::Screen::Type::TOP].toggle();
-		Video::screens[Video::Screen::Type::BOT].toggle();
-		Video::screens[Video::Screen::Type::JOINT].toggle();
+		Screenshot::Job job;
 
-		Video::screens[Video::Screen::Type::TOP].move();
-		Video::screens[Video::Screen::Type::BOT].move();
+		while (true) {
+			Screenshot::full.wait(&job);
+
+			if (job.slot == SHOT_STOP) {
+				return;
+			}
+
+			Screenshot::save(&job);
+			Screenshot::empty.push(job.slot);
+		}
+	}
+
+	static inline void copy(UCHAR *p_in, bool bot, int x, int y, int width, int height, UCHAR *p_out, int stride) {
+		for (int i = 0; i < width; ++i) {
+			int line = bot ? DELTA_RES / CAP_WIDTH + (x + i) * 2 : x + i < DELTA_RES / CAP_WIDTH ? x + i : DELTA_RES / CAP_WIDTH + (x + i - DELTA_RES / CAP_WIDTH) * 2 + 1;
+
+			for (int j = 0; j < height; ++j) {
+				UCHAR *p_src = &p_in[(line * CAP_WIDTH + CAP_WIDTH - 1 - y - j) * 3];
+				UCHAR *p_dst = &p_out[(j * stride + i) * 4];
+
+				p_dst[0] = p_src[0];
+				p_dst[1] = p_src[1];
+				p_dst[2] = p_src[2];
+				p_dst[3] = 0xff;
+			}
+		}
+	}
+
+	static inline void rotate(std::vector<UCHAR> *p_image, int *p_width, int *p_height, int rotation) {
+		if (!rotation) {
+			return;
+		}
+
+		int width = *p_width;
+		int height = *p_height;
+
+		std::vector<UCHAR> image(p_image->size());
+
+		if (rotation != 180) {
+			std::swap(*p_width, *p_height);
+		}
+
+		for (int y = 0; y < *p_height; ++y) {
+			for (int x = 0; x < *p_width; ++x) {
+				int u = rotation == 90 ? width - 1 - y : rotation == 180 ? width - 1 - x : y;
+				int v = rotation == 90 ? x : rotation == 180 ? height - 1 - y : height - 1 - x;
+
+				memcpy(&image[(y * *p_width + x) * 4], &(*p_image)[(v * width + u) * 4], 4);
+			}
+		}
+
+		p_image->swap(image);
+	}
+
+	static inline void save(Screenshot::Job *p_job) {
+		UCHAR *p_in = &Screenshot::pool[static_cast<std::size_t>(p_job->slot) * FRAME_SIZE_RGB];
+
+		int top = std::min(Video::Screen::widths[p_job->crop], Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS]);
+		int bot = std::min(Video::Screen::widths[p_job->crop], Video::Screen::widths[Video::Screen::Crop::SCALED_DS]);
+		int height = Video::Screen::heights[p_job->crop];
+
+		int width = p_job->type == Video::Screen::Type::BOT ? bot : top;
+		int rows = height * (p_job->type == Video::Screen::Type::JOINT ? 2 : 1);
+
+		std::vector<UCHAR> image(static_cast<std::size_t>(width) * rows * 4, 0x00);
+
+		if (p_job->type != Video::Screen::Type::BOT) {
+			Screenshot::copy(p_in, false, (Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS] - top) / 2, Video::Screen::heights[Video::Screen::Crop::DEFAULT_3DS] - height, top, height, &image[(width - top) / 2 * 4], width);
+		}
+
+		if (p_job->type != Video::Screen::Type::TOP) {
+			Screenshot::copy(p_in, true, (Video::Screen::widths[Video::Screen::Crop::SCALED_DS] - bot) / 2, 0, bot, height, &image[((rows - height) * width + (width - bot) / 2) * 4], width);
+		}
+
+		Screenshot::rotate(&image, &width, &rows, p_job->rotation);
+
+		char time[32];
+		std::time_t now = std::time(nullptr);
+		std::strftime(time, sizeof(time), "%Y%m%d-%H%M%S", std::localtime(&now));
+
+		std::string path = Screenshot::dir + Capture::devices[p_job->device]->m_name + "-" + time + "-" + std::to_string(p_job->sequence) + ".png";
+
+		sf::Image out;
+		out.create(width, rows, image.data());
+
+		if (!out.saveToFile(path)) {
+			printf("[%s] File \"%s\" save failed.\n", NAME, path.c_str());
+			return;
+		}
+
+		++Screenshot::saved;
+	}
+};
+
+class Stats {
+public:
+	static inline bool enabled = false;
+	static inline std::string path = STATS_PATH;
+
+	static inline void open() {
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		struct sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, Stats::path.c_str(), sizeof(addr.sun_path) - 1);
+
+		unlink(Stats::path.c_str());
+
+		if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) || listen(fd, STATS_BACKLOG)) {
+			printf("[%s] Stats socket \"%s\" open failed.\n", NAME, Stats::path.c_str());
+
+			if (fd >= 0) {
+				::close(fd);
+			}
+
+			return;
+		}
+
+		std::signal(SIGPIPE, SIG_IGN);
+
+		Stats::fd = fd;
+		Stats::thread = std::thread(Stats::serve);
 	}
 
-	static inline void poll() {
-		Video::screens[Video::Screen::Type::TOP].poll();
-		Video::screens[Video::Screen::Type::BOT].poll();
-		Video::screens[Video::Screen::Type::JOINT].poll();
+	static inline void close() {
+		if (Stats::thread.joinable()) {
+			Stats::thread.join();
+		}
+
+		if (Stats::fd >= 0) {
+			::close(Stats::fd);
+			unlink(Stats::path.c_str());
+		}
 	}
 
-	static inline bool load(UCHAR *p_buf, ULONG *p_read) {
-		if (*p_read < FRAME_SIZE_RGB) {
-			return false;
-		}
+private:
+	static inline int fd = -1;
+	static inline std::thread thread;
+
+	static inline std::vector<uint64_t> counts;
+	static inline std::vector<double> rates;
+
+	static inline sf::Int64 sampled = 0;
+
+	static inline void serve() {
+		Stats::counts.assign(Video::videos.size(), 0);
+		Stats::rates.assign(Video::videos.size(), 0.0);
+
+		Stats::sampled = Capture::now();
+
+		while (g_running) {
+			struct pollfd pfd = { Stats::fd, POLLIN, 0 };
+
+			if (::poll(&pfd, 1, STATS_POLL) > 0) {
+				int client = accept(Stats::fd, nullptr, nullptr);
 
-		Video::map(p_buf, Video::buf);
-		Video::in_tex.update(Video::buf, CAP_WIDTH, CAP_HEIGHT, 0, 0);
+				if (client >= 0) {
+					std::string text = Stats::json();
 
-		return true;
-	}
+					if (::write(client, text.data(), text.size()) < 0) {
+						printf("[%s] Stats write failed.\n", NAME);
+					}
 
-	static inline void map(UCHAR *p_in, UCHAR *p_out) {
-		for (int i = 0, j = DELTA_RES, k = TOP_RES; i < CAP_RES; ++i) {
-			if (i < DELTA_RES) {
-				p_out[4 * i + 0] = p_in[3 * i + 0];
-				p_out[4 * i + 1] = p_in[3 * i + 1];
-				p_out[4 * i + 2] = p_in[3 * i + 2];
-				p_out[4 * i + 3] = 0xff;
+					::close(client);
+				}
 			}
 
-			else if (i / CAP_WIDTH & 1) {
-				p_out[4 * j + 0] = p_in[3 * i + 0];
-				p_out[4 * j + 1] = p_in[3 * i + 1];
-				p_out[4 * j + 2] = p_in[3 * i + 2];
-				p_out[4 * j + 3] = 0xff;
+			Stats::sample();
+		}
+	}
 
-				++j;
-			}
+	static inline void sample() {
+		sf::Int64 now = Capture::now();
 
-			else {
-				p_out[4 * k + 0] = p_in[3 * i + 0];
-				p_out[4 * k + 1] = p_in[3 * i + 1];
-				p_out[4 * k + 2] = p_in[3 * i + 2];
-				p_out[4 * k + 3] = 0xff;
+		if (now - Stats::sampled < STATS_INTERVAL * 1000) {
+			return;
+		}
 
-				++k;
-			}
+		for (std::size_t i = 0; i < Video::videos.size(); ++i) {
+			uint64_t count = Video::videos[i]->m_presented;
+
+			Stats::rates[i] = (count - Stats::counts[i]) * 1000000.0 / (now - Stats::sampled);
+			Stats::counts[i] = count;
 		}
+
+		Stats::sampled = now;
+	}
+
+	static inline std::string number(uint64_t value) {
+		return std::to_string(value);
 	}
 
-	static inline void draw() {
-		if (Video::split) {
-			Video::screens[Video::Screen::Type::TOP].draw();
-			Video::screens[Video::Screen::Type::BOT].draw();
+	static inline std::string json() {
+		char buf[64];
+		snprintf(buf, sizeof(buf), "%.3f", (Capture::now() - Capture::started) / 1000000.0);
+
+		std::string text = "{\"uptime\":" + std::string(buf) + ",\"captures\":[";
+
+		for (Capture *p_capture : Capture::devices) {
+			text += p_capture->m_id ? "," : "";
+			text += "{\"name\":\"" + p_capture->m_name + "\"";
+			text += ",\"connected\":" + std::string(p_capture->m_connected ? "true" : "false");
+			text += ",\"frames\":" + Stats::number(p_capture->m_frames);
+			text += ",\"short_reads\":" + Stats::number(p_capture->m_shorts);
+			text += ",\"late\":" + Stats::number(p_capture->m_lates);
+			text += ",\"aborts\":" + Stats::number(p_capture->m_source->m_aborts);
+			text += ",\"reconnects\":" + Stats::number(p_capture->m_connects ? p_capture->m_connects - 1 : 0);
+			text += ",\"buffers\":" + std::to_string(p_capture->m_size);
+			text += ",\"buffer_waits\":" + Stats::number(p_capture->m_waits);
+			text += ",\"buffer_wait_us\":" + Stats::number(p_capture->m_waited);
+			text += ",\"stale_reads\":" + Stats::number(p_capture->m_stale);
+			text += ",\"video_queue\":" + std::to_string(p_capture->m_video.size());
+			text += ",\"audio_queue\":" + std::to_string(p_capture->m_audio.size()) + "}";
 		}
 
-		else {
-			Video::screens[Video::Screen::Type::JOINT].draw(&Video::screens[Video::Screen::Type::TOP].m_in_rect, &Video::screens[Video::Screen::Type::BOT].m_in_rect);
+		text += "],\"audio\":{\"drops\":" + Stats::number(Audio::drops);
+		text += ",\"resets\":" + Stats::number(Audio::resets);
+		text += ",\"underruns\":" + Stats::number(Audio::underruns);
+		text += ",\"overruns\":" + Stats::number(Audio::overruns);
+		text += ",\"corrections\":" + Stats::number(Audio::corrections) + "},\"videos\":[";
+
+		for (std::size_t i = 0; i < Video::videos.size(); ++i) {
+			Video *p_video = Video::videos[i];
+			snprintf(buf, sizeof(buf), "%.2f", Stats::rates[i]);
+
+			text += i ? "," : "";
+			text += "{\"name\":\"" + p_video->m_name + "\"";
+			text += ",\"fps\":" + std::string(buf);
+			text += ",\"presented\":" + Stats::number(p_video->m_presented);
+			text += ",\"dropped\":" + Stats::number(p_video->m_dropped);
+			text += ",\"duplicated\":" + Stats::number(p_video->m_duplicated);
+			text += ",\"skipped\":" + Stats::number(p_video->m_skipped) + "}";
 		}
+
+		return text + "]}\n";
 	}
 };
 
-void load(std::string path, std::string name) {
+void load(Video *p_video, std::string path, std::string name) {
 	std::ifstream file(path + name);
 
 	if (!file.good()) {
@@ -875,7 +6193,7 @@ void load(std::string path, std::string name) {
 		Video::Screen *p_screen;
 
 		if (std::getline(kvp, key, '_')) {
-			p_screen = Video::screen(key);
+			p_screen = p_video->screen(key);
 		}
 
 		if (!p_screen) {
@@ -898,12 +6216,12 @@ void load(std::string path, std::string name) {
 				}
 
 				if (key == "brightness") {
-					Video::brightness = std::clamp(std::stoi(value) / 5 * 5, 50, 150);
+					p_video->m_brightness = std::clamp(std::stoi(value) / 5 * 5, 50, 150);
 					continue;
 				}
 
 				if (key == "split") {
-					Video::split = std::stoi(value);
+					p_video->m_split = std::stoi(value);
 					continue;
 				}
 
@@ -926,12 +6244,17 @@ void load(std::string path, std::string name) {
 					p_screen->m_scale = std::clamp(static_cast<int>(std::stod(value) / 0.5) * 0.5, 1.0, 4.5);
 					continue;
 				}
+
+				if (key == "filter") {
+					p_screen->m_filter = static_cast<Scaler::Filter>((std::stoi(value) % Scaler::Filter::COUNT + Scaler::Filter::COUNT) % Scaler::Filter::COUNT);
+					continue;
+				}
 			}
 		}
 	}
 }
 
-void save(std::string path, std::string name) {
+void save(Video *p_video, std::string path, std::string name) {
 	std::filesystem::create_directories(path);
 	std::ofstream file(path + name);
 
@@ -942,20 +6265,138 @@ void save(std::string path, std::string name) {
 
 	file << "volume=" << Audio::volume << std::endl;
 	file << "mute=" << Audio::mute << std::endl;
-	file << "brightness=" << Video::brightness << std::endl;
-	file << "split=" << Video::split << std::endl;
+	file << "brightness=" << p_video->m_brightness << std::endl;
+	file << "split=" << p_video->m_split << std::endl;
 
 	for (int i = 0; i < Video::Screen::Type::SIZE; ++i) {
-		std::string key = Video::screens[i].key();
+		std::string key = p_video->m_screens[i].key();
+
+		file << key << "_blur=" << p_video->m_screens[i].m_blur << std::endl;
+		file << key << "_crop=" << p_video->m_screens[i].m_crop << std::endl;
+		file << key << "_rotation=" << p_video->m_screens[i].m_rotation << std::endl;
+		file << key << "_scale=" << std::to_string(p_video->m_screens[i].m_scale).erase(3, 5) << std::endl;
+		file << key << "_filter=" << p_video->m_screens[i].m_filter << std::endl;
+	}
+}
+
+int bench() {
+	Video::detect();
+
+	Video::bench();
+	Scaler::bench();
+	Audio::bench();
+	Soundtrack::bench();
+	Capture::bench();
+
+	Capture capture(new Capture::Synthetic());
+	Video video(&capture);
+
+	std::string path = std::filesystem::temp_directory_path().string() + "/" + NAME + "-bench/";
+	save(&video, path, "bench.conf");
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < BENCH_COUNT; ++i) {
+		save(&video, path, "bench.conf");
+	}
+
+	auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	Bench::record("config.save", time / BENCH_COUNT, "ns/file");
+
+	start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < BENCH_COUNT; ++i) {
+		load(&video, path, "bench.conf");
+	}
+
+	time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	Bench::record("config.load", time / BENCH_COUNT, "ns/file");
+
+	std::filesystem::remove_all(path);
+
+	std::vector<UCHAR> out(FRAME_SIZE_RGBA);
+
+	Capture::audible = true;
+
+	for (Capture *p_capture : Capture::devices) {
+		p_capture->m_source->m_paced = false;
+		p_capture->allocate();
+
+		if (!(p_capture->m_connected = p_capture->connect())) {
+			Bench::record("pipeline." + std::to_string(p_capture->m_id), 0, "ns/packet", false);
+			continue;
+		}
+
+		g_running = true;
+		g_finished = false;
+
+		std::thread capture = std::thread(&Capture::stream, p_capture);
+
+		Capture::Frame frame;
+		int packets = 0;
+
+		start = std::chrono::steady_clock::now();
+
+		while (packets < BENCH_PACKETS) {
+			p_capture->m_video.wait(&frame);
+
+			if (frame.index == TRANSFER_ABORT) {
+				if (!p_capture->m_connected) {
+					break;
+				}
+
+				continue;
+			}
+
+			if (!p_capture->acquire(frame)) {
+				continue;
+			}
+
+			Video::map(p_capture->m_buf[frame.index], out.data());
+			p_capture->release(frame.index);
+
+			while (p_capture->m_audio.pop(&frame)) {
+				if (frame.index != TRANSFER_ABORT && p_capture->acquire(frame)) {
+					Audio::load(&p_capture->m_buf[frame.index][FRAME_SIZE_RGB], &p_capture->m_read[frame.index], frame.time);
+					Audio::drain();
+
+					p_capture->release(frame.index);
+				}
+			}
+
+			++packets;
+		}
 
-		file << key << "_blur=" << Video::screens[i].m_blur << std::endl;
-		file << key << "_crop=" << Video::screens[i].m_crop << std::endl;
-		file << key << "_rotation=" << Video::screens[i].m_rotation << std::endl;
-		file << key << "_scale=" << std::to_string(Video::screens[i].m_scale).erase(3, 5) << std::endl;
+		time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		g_running = false;
+		g_finished = true;
+
+		capture.join();
+
+		Bench::record("pipeline." + std::to_string(p_capture->m_id), packets ? time / packets : 0, "ns/packet", packets == BENCH_PACKETS);
+		printf("[%s] Pipeline %d: %d packets from %llu captured, %.2f FPS.\n", NAME, p_capture->m_id, packets, static_cast<unsigned long long>(p_capture->m_frames), packets ? 1e9 * packets / time : 0.0);
 	}
+
+	Capture::release();
+
+	return Bench::finish();
 }
 
 int main(int argc, char **argv) {
+	Capture::started = Capture::now();
+
+	std::vector<Capture::Synthetic*> synthetics;
+
+	int short_count = 0;
+	int stall_count = 0;
+
+	bool record = false;
+	bool sound = false;
+
+	Recorder::dir = CONF_DIR + "captures/";
+	Screenshot::dir = CONF_DIR + "screenshots/";
+
 	for (int i = 1; i < argc; ++i) {
 		if (strcmp(argv[i], "--auto") == 0) {
 			Capture::auto_connect = true;
@@ -972,45 +6413,370 @@ int main(int argc, char **argv) {
 			continue;
 		}
 
+		if (strcmp(argv[i], "--record") == 0) {
+			record = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--record-audio") == 0) {
+			sound = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--flac") == 0) {
+			Soundtrack::flac = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--compress") == 0) {
+			Recorder::compress = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+			bool verified = Recorder::verify(argv[++i]);
+			Capture::release();
+
+			return verified ? 0 : 1;
+		}
+
+		if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			Recorder::dir = std::string(argv[++i]) + "/";
+			continue;
+		}
+
+		if (strcmp(argv[i], "--shots") == 0 && i + 1 < argc) {
+			Screenshot::dir = std::string(argv[++i]) + "/";
+			continue;
+		}
+
+		if (strcmp(argv[i], "--shot") == 0 && i + 1 < argc) {
+			std::string key = argv[++i];
+			Screenshot::layout = key == "top" ? Video::Screen::Type::TOP : key == "bot" ? Video::Screen::Type::BOT : key == "joint" ? Video::Screen::Type::JOINT : Video::Screen::Type::SIZE;
+
+			continue;
+		}
+
+		if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+			Video::burst = std::max(std::atoi(argv[++i]), 1);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--bench") == 0) {
+			Bench::enabled = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+			Bench::results = argv[++i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			Bench::baseline = argv[++i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+			Bench::threshold = std::max(std::atof(argv[++i]), 0.0);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+			Audio::latency = std::max(std::atoi(argv[++i]), 0);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--headless") == 0) {
+			Headless::enabled = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+			Headless::video_path = argv[++i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) {
+			Headless::audio_path = argv[++i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			Headless::format = strcmp(argv[++i], "rgba") == 0 ? Headless::Format::RGBA : Headless::Format::RGB;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+			std::string key = argv[++i];
+			Headless::layout = key == "top" ? Video::Screen::Type::TOP : key == "bot" ? Video::Screen::Type::BOT : Video::Screen::Type::JOINT;
+
+			continue;
+		}
+
+		if (strcmp(argv[i], "--drop") == 0) {
+			Headless::blocking = false;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--shared") == 0) {
+			Publisher::enabled = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--stats") == 0) {
+			Stats::enabled = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--gpu") == 0) {
+			Video::gpu = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--buffers") == 0 && i + 1 < argc) {
+			Capture::count = std::atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+			Capture::depth = std::atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--capture-cpu") == 0 && i + 1 < argc) {
+			Realtime::cpus[Realtime::Thread::CAPTURE] = std::atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--audio-cpu") == 0 && i + 1 < argc) {
+			Realtime::cpus[Realtime::Thread::AUDIO] = std::atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--render-cpu") == 0 && i + 1 < argc) {
+			Realtime::cpus[Realtime::Thread::RENDER] = std::atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--realtime") == 0 && i + 1 < argc) {
+			Realtime::policy = strcmp(argv[++i], "rr") == 0 ? SCHED_RR : SCHED_FIFO;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+			Realtime::priority = std::atoi(argv[++i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--lock") == 0) {
+			Realtime::lock = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--tune") == 0) {
+			Capture::tune = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--list") == 0) {
+			std::vector<std::string> serials = Capture::Device::list();
+
+			for (std::size_t j = 0; j < serials.size(); ++j) {
+				printf("[%s] Device %zu: %s.\n", NAME, j, serials[j].c_str());
+			}
+
+			Capture::release();
+
+			return 0;
+		}
+
+		if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+			std::string key = argv[++i];
+			Capture::devices.push_back(new Capture(key.find_first_not_of("0123456789") == std::string::npos ? new Capture::Device(std::stoi(key)) : new Capture::Device(key)));
+
+			continue;
+		}
+
+		if (strcmp(argv[i], "--synthetic") == 0) {
+			synthetics.push_back(new Capture::Synthetic());
+			Capture::devices.push_back(new Capture(synthetics.back()));
+
+			continue;
+		}
+
+		if (strcmp(argv[i], "--short") == 0 && i + 1 < argc) {
+			short_count = std::max(std::atoi(argv[++i]), 0);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--stall") == 0 && i + 1 < argc) {
+			stall_count = std::max(std::atoi(argv[++i]), 0);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			Capture::devices.push_back(new Capture(new Capture::Replay(argv[++i])));
+			continue;
+		}
+
+		if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+			Capture::Replay::speed = std::max(std::atof(argv[++i]), 0.0);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+			Capture::Replay::offset = std::max(std::atof(argv[++i]), 0.0);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--step") == 0) {
+			Capture::Replay::stepping = true;
+			continue;
+		}
+
 		printf("[%s] Invalid argument \"%s\".\n", NAME, argv[i]);
 	}
 
-	if (!g_safe_mode) {
-		load(CONF_DIR, std::string(NAME) + ".conf");
+	if (Bench::enabled) {
+		return bench();
+	}
+
+	if (Capture::devices.empty()) {
+		Capture::devices.push_back(new Capture(new Capture::Device()));
+	}
+
+	for (Capture::Synthetic *p_synthetic : synthetics) {
+		p_synthetic->m_short = short_count;
+		p_synthetic->m_stall = stall_count;
+	}
+
+	for (Capture *p_capture : Capture::devices) {
+		if (Publisher::enabled) {
+			p_capture->m_publisher = new Publisher(p_capture->m_name);
+		}
+
+		p_capture->allocate();
+	}
+
+	if (Headless::enabled) {
+		if (!Headless::open()) {
+			Capture::release();
+			return 1;
+		}
+
+		Realtime::print();
+
+		if (record) {
+			Recorder::toggle(0);
+		}
+
+		if (sound) {
+			Soundtrack::toggle(0);
+		}
+
+		if (Stats::enabled) {
+			Stats::open();
+		}
+
+		std::thread capture = std::thread(&Capture::stream, Capture::devices[0]);
+		Headless::run();
+
+		g_finished = true;
+		capture.join();
+
+		Stats::close();
+		Recorder::close();
+		Soundtrack::close();
+		Headless::close();
+
+		Capture::release();
+
+		return 0;
 	}
 
-	Capture::connected = Capture::connect();
 	Audio::p_audio = new Audio();
+	Audio::pin();
+
+	Capture::audible = true;
+
+	Video::detect();
 
 	Video::p_load = &load;
 	Video::p_save = &save;
+	Video::p_shoot = &Screenshot::take;
+
+	for (Capture *p_capture : Capture::devices) {
+		Video *p_video = new Video(p_capture);
+
+		if (!g_safe_mode) {
+			load(p_video, CONF_DIR, p_video->m_name + ".conf");
+		}
+
+		p_video->create();
+		Video::videos.push_back(p_video);
+	}
+
+	Realtime::print();
+
+	if (record) {
+		Recorder::toggle(0);
+	}
+
+	if (sound) {
+		Soundtrack::toggle(0);
+	}
 
-	Video::screens[Video::Screen::Type::TOP].build(Video::Screen::Type::TOP, 0, Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], Video::split);
-	Video::screens[Video::Screen::Type::BOT].build(Video::Screen::Type::BOT, Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], Video::Screen::widths[Video::Screen::Crop::SCALED_DS], Video::split);
-	Video::screens[Video::Screen::Type::JOINT].build(Video::Screen::Type::JOINT, 0, Video::Screen::widths[Video::Screen::Crop::DEFAULT_3DS], !Video::split);
+	if (Stats::enabled) {
+		Stats::open();
+	}
 
-	Video::shader.loadFromMemory(Video::frag, sf::Shader::Fragment);
-	Video::in_tex.create(CAP_WIDTH, CAP_HEIGHT);
+	std::vector<std::thread> captures;
 
-	Video::init();
-	Video::blank();
+	for (Capture *p_capture : Capture::devices) {
+		captures.emplace_back(&Capture::stream, p_capture);
+	}
 
-	std::thread capture = std::thread(Capture::stream, &Audio::promise, &Video::promise, &Audio::waiting, &Video::waiting);
 	std::thread audio = std::thread(Audio::playback);
+	std::thread render = std::thread(Video::render);
+
+	Video::run();
 
-	Video::render();
+	render.join();
 	audio.join();
 
 	g_finished = true;
-	capture.join();
 
-	Video::screens[Video::Screen::Type::TOP].m_win.close();
-	Video::screens[Video::Screen::Type::BOT].m_win.close();
-	Video::screens[Video::Screen::Type::JOINT].m_win.close();
+	for (std::thread &capture : captures) {
+		capture.join();
+	}
+
+	Stats::close();
+	Recorder::close();
+	Soundtrack::close();
+	Screenshot::close();
 
-	if (!g_safe_mode) {
-		save(CONF_DIR, std::string(NAME) + ".conf");
+	for (Capture *p_capture : Capture::devices) {
+		p_capture->print();
 	}
 
+	Latency::print();
+	Audio::print();
+
+	for (Video *p_video : Video::videos) {
+		p_video->print();
+		p_video->close();
+
+		if (!g_safe_mode) {
+			save(p_video, CONF_DIR, p_video->m_name + ".conf");
+		}
+
+		delete p_video;
+	}
+
+	delete Scaler::p_scaler;
+
+	Capture::release();
+
 	return 0;
 }
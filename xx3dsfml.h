@@ -0,0 +1,207 @@
+/*
+ * This software is provided as is, without any warranty, express or implied.
+ * This software is licensed under a Creative Commons (CC BY-NC-SA) license.
+ * This software is authored by Chris Malnick (2023, 2024).
+ */
+
+#ifndef XX3DSFML_H
+#define XX3DSFML_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHARED_MAGIC 0x4d485333
+#define SHARED_VERSION 1
+
+#define SHARED_COUNT 8
+
+#define SHARED_WIDTH 240
+#define SHARED_HEIGHT (400 + 320)
+
+#define SHARED_VIDEO (SHARED_WIDTH * SHARED_HEIGHT * 3)
+#define SHARED_AUDIO 2192
+
+#define SHARED_ALIGN 4096
+#define SHARED_STRIDE ((sizeof(Shared::Slot) + SHARED_VIDEO + SHARED_AUDIO + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN)
+#define SHARED_SIZE (SHARED_ALIGN + SHARED_COUNT * SHARED_STRIDE)
+
+#define STATS_PATH "/tmp/xx3dsfml.sock"
+
+class Shared {
+public:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+
+		uint32_t count;
+		uint32_t stride;
+
+		uint32_t width;
+		uint32_t height;
+
+		uint32_t sample_rate;
+		uint32_t channels;
+
+		std::atomic<uint64_t> head;
+		uint64_t reserved[3];
+	};
+
+	struct Slot {
+		std::atomic<uint64_t> lock;
+		uint64_t index;
+
+		uint64_t sequence;
+		int64_t time;
+
+		uint32_t video;
+		uint32_t audio;
+
+		uint64_t reserved[3];
+	};
+
+	struct View {
+		const uint8_t *p_video;
+		const uint8_t *p_audio;
+
+		uint64_t index;
+		uint64_t sequence;
+		int64_t time;
+
+		uint32_t video;
+		uint32_t audio;
+
+		uint64_t lock;
+	};
+
+	static_assert(sizeof(Shared::Header) == 64, "Shared header size mismatch.");
+	static_assert(sizeof(Shared::Slot) == 64, "Shared slot size mismatch.");
+
+	static inline Shared::Slot *slot(void *p_base, uint64_t index) {
+		return reinterpret_cast<Shared::Slot*>(static_cast<uint8_t*>(p_base) + SHARED_ALIGN + index % SHARED_COUNT * SHARED_STRIDE);
+	}
+
+	static inline const uint8_t *pixel(const Shared::View *p_view, bool bot, int x, int y) {
+		int line = bot ? 400 + x : x;
+		return &p_view->p_video[(line * SHARED_WIDTH + SHARED_WIDTH - 1 - y) * 3];
+	}
+
+	class Reader {
+	public:
+		uint64_t m_lost = 0;
+		uint64_t m_torn = 0;
+
+		~Reader() {
+			this->detach();
+		}
+
+		bool attach(std::string name) {
+			this->detach();
+
+			int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+			if (fd < 0) {
+				return false;
+			}
+
+			void *p_base = mmap(nullptr, SHARED_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+
+			if (p_base == MAP_FAILED) {
+				return false;
+			}
+
+			Shared::Header *p_header = static_cast<Shared::Header*>(p_base);
+
+			if (p_header->magic != SHARED_MAGIC || p_header->version != SHARED_VERSION || p_header->count != SHARED_COUNT || p_header->stride != SHARED_STRIDE) {
+				munmap(p_base, SHARED_SIZE);
+				return false;
+			}
+
+			this->m_base = p_base;
+
+			uint64_t head = p_header->head.load(std::memory_order_acquire);
+			this->m_next = head ? head - 1 : 0;
+
+			return true;
+		}
+
+		void detach() {
+			if (this->m_base) {
+				munmap(this->m_base, SHARED_SIZE);
+				this->m_base = nullptr;
+			}
+		}
+
+		bool attached() {
+			return this->m_base;
+		}
+
+		bool acquire(Shared::View *p_view) {
+			if (!this->m_base) {
+				return false;
+			}
+
+			uint64_t head = static_cast<Shared::Header*>(this->m_base)->head.load(std::memory_order_acquire);
+
+			if (this->m_next >= head) {
+				return false;
+			}
+
+			if (head - this->m_next > SHARED_COUNT - 1) {
+				this->m_lost += head - this->m_next - (SHARED_COUNT - 1);
+				this->m_next = head - (SHARED_COUNT - 1);
+			}
+
+			Shared::Slot *p_slot = Shared::slot(this->m_base, this->m_next);
+			uint64_t lock = p_slot->lock.load(std::memory_order_acquire);
+
+			if (lock & 1 || p_slot->index != this->m_next) {
+				++this->m_lost;
+				++this->m_next;
+
+				return false;
+			}
+
+			p_view->p_video = reinterpret_cast<const uint8_t*>(p_slot) + sizeof(Shared::Slot);
+			p_view->p_audio = p_view->p_video + SHARED_VIDEO;
+
+			p_view->index = p_slot->index;
+			p_view->sequence = p_slot->sequence;
+			p_view->time = p_slot->time;
+
+			p_view->video = p_slot->video;
+			p_view->audio = p_slot->audio;
+
+			p_view->lock = lock;
+
+			return true;
+		}
+
+		bool release(Shared::View *p_view) {
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			bool valid = Shared::slot(this->m_base, p_view->index)->lock.load(std::memory_order_relaxed) == p_view->lock;
+
+			if (!valid) {
+				++this->m_torn;
+			}
+
+			++this->m_next;
+
+			return valid;
+		}
+
+	private:
+		void *m_base = nullptr;
+		uint64_t m_next = 0;
+	};
+};
+
+#endif
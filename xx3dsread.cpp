@@ -0,0 +1,92 @@
+/*
+ * This software is provided as is, without any warranty, express or implied.
+ * This software is licensed under a Creative Commons (CC BY-NC-SA) license.
+ * This software is authored by Chris Malnick (2023, 2024).
+ */
+
+#include "xx3dsfml.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <thread>
+
+#define NAME "xx3dsread"
+
+#define POLL_TIME 1
+#define REPORT_TIME 1000
+#define ATTACH_TIME 1000
+
+bool g_running = true;
+
+void stop(int) {
+	g_running = false;
+}
+
+int64_t now() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+	std::string name = argc > 1 ? argv[1] : "/xx3dsfml";
+
+	std::signal(SIGINT, stop);
+	std::signal(SIGTERM, stop);
+
+	Shared::Reader reader;
+	Shared::View view;
+
+	uint64_t frames = 0;
+	uint64_t gaps = 0;
+	uint64_t last = 0;
+
+	uint8_t pixel[3] = {};
+
+	bool first = true;
+
+	int64_t report = now();
+	int64_t received = now();
+
+	while (g_running) {
+		if (!reader.attached() || now() - received > ATTACH_TIME) {
+			if (reader.attach(name)) {
+				printf("[%s] Attached to \"%s\".\n", NAME, name.c_str());
+				first = true;
+			}
+
+			received = now();
+		}
+
+		if (!reader.acquire(&view)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_TIME));
+		}
+
+		else {
+			uint64_t sequence = view.sequence;
+			uint8_t center[3];
+
+			memcpy(center, Shared::pixel(&view, false, 200, 120), sizeof(center));
+
+			if (reader.release(&view)) {
+				if (!first && sequence != last + 1) {
+					gaps += sequence - last - 1;
+				}
+
+				first = false;
+				last = sequence;
+
+				memcpy(pixel, center, sizeof(pixel));
+
+				++frames;
+				received = now();
+			}
+		}
+
+		if (now() - report >= REPORT_TIME) {
+			printf("[%s] Frames %llu, sequence gaps %llu, lost %llu, torn %llu, top center #%02x%02x%02x.\n", NAME, static_cast<unsigned long long>(frames), static_cast<unsigned long long>(gaps), static_cast<unsigned long long>(reader.m_lost), static_cast<unsigned long long>(reader.m_torn), pixel[0], pixel[1], pixel[2]);
+			report = now();
+		}
+	}
+
+	return gaps || reader.m_torn ? 1 : 0;
+}
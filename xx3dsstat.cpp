@@ -0,0 +1,78 @@
+/*
+ * This software is provided as is, without any warranty, express or implied.
+ * This software is licensed under a Creative Commons (CC BY-NC-SA) license.
+ * This software is authored by Chris Malnick (2023, 2024).
+ */
+
+#include "xx3dsfml.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define NAME "xx3dsstat"
+
+#define READ_SIZE 4096
+
+bool g_running = true;
+
+void stop(int) {
+	g_running = false;
+}
+
+bool query(std::string path, std::string *p_text) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	struct sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))) {
+		if (fd >= 0) {
+			close(fd);
+		}
+
+		return false;
+	}
+
+	char buf[READ_SIZE];
+	ssize_t count;
+
+	p_text->clear();
+
+	while ((count = read(fd, buf, sizeof(buf))) > 0) {
+		p_text->append(buf, count);
+	}
+
+	close(fd);
+
+	return count == 0 && !p_text->empty();
+}
+
+int main(int argc, char **argv) {
+	std::string path = argc > 1 ? argv[1] : STATS_PATH;
+	int interval = argc > 2 ? std::stoi(argv[2]) : 0;
+
+	std::signal(SIGINT, stop);
+	std::signal(SIGTERM, stop);
+
+	std::string text;
+
+	do {
+		if (!query(path, &text)) {
+			printf("[%s] Query \"%s\" failed.\n", NAME, path.c_str());
+			return 1;
+		}
+
+		fputs(text.c_str(), stdout);
+		fflush(stdout);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+	} while (interval > 0 && g_running);
+
+	return 0;
+}